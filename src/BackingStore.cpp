@@ -0,0 +1,398 @@
+#include "BackingStore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+constexpr size_t BackingStore::kMaxSlotSize;
+constexpr uint32_t BackingStore::kNoSlot;
+constexpr size_t BackingStore::kMaxSlots;
+
+BackingStore::BackingStore()
+    : slotSize(kMaxSlotSize), numSlots(0), initialSlots(0),
+    numQueuedWrites(0), numStoredPages(0), numReads(0), numWrites(0), numWriteBatches(0) {}
+
+BackingStore::~BackingStore() {
+    if (swapFile.isOpen()) {
+        swapFile.close();
+        std::remove(swapPath.c_str());
+    }
+}
+
+void BackingStore::initialize(const std::string& path, size_t pageSize, size_t initialBytes) {
+    pages.clear();
+    pendingWrites.clear();
+    writeQueue.clear();
+    numQueuedWrites = 0;
+    numStoredPages = 0;
+    numReads = 0;
+    numWrites = 0;
+    numWriteBatches = 0;
+
+    slotSize = std::max<size_t>(1, std::min(pageSize, kMaxSlotSize));
+    initialSlots = std::max<size_t>(1, std::min(kMaxSlots, (initialBytes + slotSize - 1) / slotSize));
+    numSlots = initialSlots;
+    freeSlots.reset(kMaxSlots);
+    refCounts.assign(numSlots, 0);
+    nextSlot.assign(numSlots, kNoSlot);
+
+    swapPath = path;
+    memoryArea.clear();
+    if (!swapFile.create(swapPath, numSlots * slotSize)) {
+        std::cerr << "Failed to create swap file " << swapPath << "; swapping to host memory" << std::endl;
+        memoryArea.assign(numSlots * slotSize, 0);
+    }
+}
+
+void BackingStore::storePage(int processId, uint32_t page, const uint8_t* data, size_t size) {
+    auto& processPages = pages[processId];
+    auto it = processPages.find(page);
+    if (it == processPages.end()) {
+        it = processPages.emplace(page, StoredPage{ kNoSlot, 0 }).first;
+        numStoredPages++;
+    }
+
+    // A private copy of the same length is overwritten in place. One still
+    // shared with a fork, or pinned by a transfer, is left alone and the
+    // page gets fresh slots.
+    StoredPage& stored = it->second;
+    if (stored.firstSlot == kNoSlot || refCounts[stored.firstSlot] > 1
+        || chainLength(stored.size) != chainLength(size)) {
+        if (stored.firstSlot != kNoSlot) {
+            releaseChain(stored.firstSlot);
+        }
+        stored.firstSlot = allocateChain(size);
+    }
+    stored.size = static_cast<uint32_t>(size);
+    numWrites++;
+    if (stored.firstSlot == kNoSlot) {
+        return;
+    }
+
+    // Writes to a page whose batch has not been taken yet coalesce
+    std::shared_ptr<PendingWrite>& pending = pendingWrites[stored.firstSlot];
+    if (!pending) {
+        pending = std::make_shared<PendingWrite>();
+        writeQueue.push_back(stored.firstSlot);
+        numQueuedWrites++;
+    }
+    pending->data.assign(data, data + size);
+}
+
+bool BackingStore::loadPage(int processId, uint32_t page, uint8_t* data, size_t size) {
+    auto processIt = pages.find(processId);
+    if (processIt == pages.end()) {
+        return false;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end() || it->second.firstSlot == kNoSlot) {
+        return false;
+    }
+    size_t stored = std::min<size_t>(size, it->second.size);
+    auto pending = pendingWrites.find(it->second.firstSlot);
+    if (pending != pendingWrites.end()) {
+        std::memcpy(data, pending->second->data.data(), stored);
+    }
+    else {
+        copyFromSlots(chainSlots(it->second.firstSlot), data, stored);
+    }
+    std::memset(data + stored, 0, size - stored);
+    numReads++;
+    return true;
+}
+
+SwapRead BackingStore::beginRead(int processId, uint32_t page, uint8_t* data, size_t size, SwapIo::Request& request) {
+    auto processIt = pages.find(processId);
+    if (processIt == pages.end()) {
+        return SwapRead::Missing;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end() || it->second.firstSlot == kNoSlot) {
+        return SwapRead::Missing;
+    }
+    uint32_t first = it->second.firstSlot;
+    if (pendingWrites.find(first) != pendingWrites.end()) {
+        // Still in the write buffer, so no I/O is needed
+        loadPage(processId, page, data, size);
+        return SwapRead::Done;
+    }
+
+    // The pin keeps the slots from being freed and reused mid-transfer
+    size_t stored = std::min<size_t>(size, it->second.size);
+    std::vector<uint32_t> slots = chainSlots(first);
+    retainChain(first);
+    request.transfer = [this, slots, data, stored, size]() {
+        copyFromSlots(slots, data, stored);
+        std::memset(data + stored, 0, size - stored);
+    };
+    request.complete = [this, first]() {
+        releaseChain(first);
+    };
+    numReads++;
+    return SwapRead::Queued;
+}
+
+bool BackingStore::takeWriteBatch(SwapIo::Request& request, size_t maxPages) {
+    struct Write {
+        uint32_t firstSlot;
+        std::vector<uint32_t> slots;
+        std::shared_ptr<PendingWrite> pending;
+    };
+    auto batch = std::make_shared<std::vector<Write>>();
+
+    size_t consumed = 0;
+    while (consumed < writeQueue.size() && batch->size() < maxPages) {
+        uint32_t first = writeQueue[consumed++];
+        auto it = pendingWrites.find(first);
+        if (it == pendingWrites.end() || it->second->submitted) {
+            continue;
+        }
+        it->second->submitted = true;
+        retainChain(first);
+        batch->push_back({ first, chainSlots(first), it->second });
+    }
+    writeQueue.erase(writeQueue.begin(), writeQueue.begin() + consumed);
+    if (batch->empty()) {
+        return false;
+    }
+    numQueuedWrites -= batch->size();
+    numWriteBatches++;
+
+    request.transfer = [this, batch]() {
+        for (const Write& write : *batch) {
+            copyToSlots(write.slots, write.pending->data.data(), write.pending->data.size());
+        }
+    };
+    request.complete = [this, batch]() {
+        for (const Write& write : *batch) {
+            auto it = pendingWrites.find(write.firstSlot);
+            if (it != pendingWrites.end() && it->second == write.pending) {
+                pendingWrites.erase(it);
+            }
+            releaseChain(write.firstSlot);
+        }
+    };
+    return true;
+}
+
+void BackingStore::sharePage(int fromProcessId, int toProcessId, uint32_t page) {
+    auto processIt = pages.find(fromProcessId);
+    if (processIt == pages.end()) {
+        return;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end()) {
+        return;
+    }
+    StoredPage shared = it->second;
+    auto& target = pages[toProcessId];
+    auto existing = target.find(page);
+    if (existing == target.end()) {
+        numStoredPages++;
+    }
+    else if (existing->second.firstSlot == shared.firstSlot) {
+        return;
+    }
+    else if (existing->second.firstSlot != kNoSlot) {
+        releaseChain(existing->second.firstSlot);
+    }
+    if (shared.firstSlot != kNoSlot) {
+        retainChain(shared.firstSlot);
+    }
+    target[page] = shared;
+}
+
+void BackingStore::clonePages(int parentId, int childId) {
+    auto processIt = pages.find(parentId);
+    if (processIt == pages.end()) {
+        return;
+    }
+    releaseProcess(childId);
+    // Element references survive the rehash an insert can trigger
+    const auto& parentPages = processIt->second;
+    for (const auto& pair : parentPages) {
+        if (pair.second.firstSlot != kNoSlot) {
+            retainChain(pair.second.firstSlot);
+        }
+    }
+    pages[childId] = parentPages;
+    numStoredPages += parentPages.size();
+}
+
+void BackingStore::releasePage(int processId, uint32_t page) {
+    auto processIt = pages.find(processId);
+    if (processIt == pages.end()) {
+        return;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end()) {
+        return;
+    }
+    if (it->second.firstSlot != kNoSlot) {
+        releaseChain(it->second.firstSlot);
+    }
+    processIt->second.erase(it);
+    numStoredPages--;
+}
+
+void BackingStore::releaseProcess(int processId) {
+    auto it = pages.find(processId);
+    if (it != pages.end()) {
+        for (const auto& pair : it->second) {
+            if (pair.second.firstSlot != kNoSlot) {
+                releaseChain(pair.second.firstSlot);
+            }
+        }
+        numStoredPages -= it->second.size();
+        pages.erase(it);
+    }
+}
+
+void BackingStore::trim() {
+    // Slots are handed out lowest first, so the tail is usually empty
+    size_t used = numSlots;
+    while (used > 0 && refCounts[used - 1] == 0) {
+        used--;
+    }
+    size_t target = numSlots;
+    while (target / 2 >= initialSlots && target / 2 >= used * 2) {
+        target /= 2;
+    }
+    if (target < numSlots) {
+        resizeArea(target);
+    }
+}
+
+unsigned int BackingStore::getNumReads() const {
+    return numReads;
+}
+
+unsigned int BackingStore::getNumWrites() const {
+    return numWrites;
+}
+
+unsigned int BackingStore::getNumWriteBatches() const {
+    return numWriteBatches;
+}
+
+size_t BackingStore::getNumQueuedWrites() const {
+    return numQueuedWrites;
+}
+
+size_t BackingStore::getNumStoredPages() const {
+    return numStoredPages;
+}
+
+size_t BackingStore::getNumUsedSlots() const {
+    return freeSlots.getNumUsed();
+}
+
+size_t BackingStore::getSlotSize() const {
+    return slotSize;
+}
+
+size_t BackingStore::getSwapSize() const {
+    return numSlots * slotSize;
+}
+
+uint8_t* BackingStore::slotData(uint32_t slot) {
+    uint8_t* base = swapFile.isOpen() ? swapFile.data() : memoryArea.data();
+    return base + static_cast<size_t>(slot) * slotSize;
+}
+
+std::vector<uint32_t> BackingStore::chainSlots(uint32_t slot) const {
+    std::vector<uint32_t> slots;
+    for (; slot != kNoSlot; slot = nextSlot[slot]) {
+        slots.push_back(slot);
+    }
+    return slots;
+}
+
+void BackingStore::copyToSlots(const std::vector<uint32_t>& slots, const uint8_t* data, size_t size) {
+    std::shared_lock<std::shared_timed_mutex> lock(areaMutex);
+    size_t offset = 0;
+    for (size_t i = 0; i < slots.size() && offset < size; ++i) {
+        size_t length = std::min(slotSize, size - offset);
+        std::memcpy(slotData(slots[i]), data + offset, length);
+        offset += length;
+    }
+}
+
+void BackingStore::copyFromSlots(const std::vector<uint32_t>& slots, uint8_t* data, size_t size) {
+    std::shared_lock<std::shared_timed_mutex> lock(areaMutex);
+    size_t offset = 0;
+    for (size_t i = 0; i < slots.size() && offset < size; ++i) {
+        size_t length = std::min(slotSize, size - offset);
+        std::memcpy(data + offset, slotData(slots[i]), length);
+        offset += length;
+    }
+}
+
+size_t BackingStore::chainLength(size_t size) const {
+    return std::max<size_t>(1, (size + slotSize - 1) / slotSize);
+}
+
+uint32_t BackingStore::allocateChain(size_t size) {
+    uint32_t first = kNoSlot;
+    uint32_t last = kNoSlot;
+    for (size_t i = chainLength(size); i > 0; --i) {
+        int slot = freeSlots.allocate();
+        if (slot < 0) {
+            break;
+        }
+        if (static_cast<size_t>(slot) >= numSlots) {
+            resizeArea(std::min(kMaxSlots, std::max(numSlots * 2, static_cast<size_t>(slot) + 1)));
+        }
+        refCounts[slot] = 1;
+        nextSlot[slot] = kNoSlot;
+        if (last == kNoSlot) {
+            first = static_cast<uint32_t>(slot);
+        }
+        else {
+            nextSlot[last] = static_cast<uint32_t>(slot);
+        }
+        last = static_cast<uint32_t>(slot);
+    }
+    return first;
+}
+
+void BackingStore::retainChain(uint32_t slot) {
+    for (; slot != kNoSlot; slot = nextSlot[slot]) {
+        refCounts[slot]++;
+    }
+}
+
+void BackingStore::releaseChain(uint32_t slot) {
+    if (refCounts[slot] == 1) {
+        // Nothing will read the page again, so a write not yet taken is dropped
+        auto pending = pendingWrites.find(slot);
+        if (pending != pendingWrites.end() && !pending->second->submitted) {
+            pendingWrites.erase(pending);
+            numQueuedWrites--;
+        }
+    }
+    while (slot != kNoSlot) {
+        uint32_t next = nextSlot[slot];
+        if (--refCounts[slot] == 0) {
+            nextSlot[slot] = kNoSlot;
+            freeSlots.markFree(static_cast<int>(slot));
+        }
+        slot = next;
+    }
+}
+
+void BackingStore::resizeArea(size_t slots) {
+    std::unique_lock<std::shared_timed_mutex> lock(areaMutex);
+    refCounts.resize(slots, 0);
+    nextSlot.resize(slots, kNoSlot);
+    numSlots = slots;
+    if (!swapFile.isOpen()) {
+        memoryArea.resize(slots * slotSize, 0);
+    }
+    else if (!swapFile.resize(slots * slotSize)) {
+        // The mapping is gone along with the pages in it; they read back as zeros
+        std::cerr << "Failed to resize swap file " << swapPath << "; swapping to host memory" << std::endl;
+        memoryArea.assign(slots * slotSize, 0);
+    }
+}
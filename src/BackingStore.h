@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FrameBitmap.h"
+#include "MappedFile.h"
+#include "SwapIo.h"
+
+enum class SwapRead {
+    Missing,    // never written out; the caller zero-fills
+    Done,       // copied before returning
+    Queued      // the returned request copies it
+};
+
+// Holds the contents of pages evicted from physical memory, keyed by
+// process ID and virtual page number, in one swap file mapped into memory.
+// The file is cut into fixed-size slots tracked by a free-slot bitmap; a
+// stored page takes a chain of slots, a single one unless the page is
+// larger than a slot. Reads copy straight from the mapping into frames
+// with no staging buffer. Stored pages are immutable and every
+// slot is reference counted, so a forked process shares its parent's
+// copies until either one writes the page out again. The file doubles
+// when its slots run out and trim() hands the unused tail back.
+//
+// Writes are buffered and reach the file in batches taken by
+// takeWriteBatch; until then, and while a batch is in flight, reads are
+// served from the buffer. Reads of pages already in the file can be
+// handed off as requests as well. Only the transfer half of a request
+// may run unlocked; everything else, completions included, runs under
+// the lock MemoryManager holds around every call.
+class BackingStore {
+public:
+    static constexpr size_t kMaxSlotSize = 4096;
+
+    BackingStore();
+    ~BackingStore();
+
+    // Creates the swap file at path with room for initialBytes, dropping
+    // anything stored before. Slots are pageSize bytes, capped at
+    // kMaxSlotSize. If the file cannot be created the slots are kept in
+    // host memory instead.
+    void initialize(const std::string& path, size_t pageSize, size_t initialBytes);
+
+    // Buffers the page for the next write batch
+    void storePage(int processId, uint32_t page, const uint8_t* data, size_t size);
+
+    // Copies a stored page into data. Returns false if the page was never
+    // written out, in which case the caller zero-fills it.
+    bool loadPage(int processId, uint32_t page, uint8_t* data, size_t size);
+
+    // Like loadPage, but a page that has to come from the file is left to
+    // request: its transfer fills data, which must stay valid until then,
+    // and its completion unpins the slots
+    SwapRead beginRead(int processId, uint32_t page, uint8_t* data, size_t size, SwapIo::Request& request);
+
+    // Takes up to maxPages buffered writes as one request. Returns false if
+    // none are waiting.
+    bool takeWriteBatch(SwapIo::Request& request, size_t maxPages);
+
+    // Gives toProcessId the same stored copy of a page that fromProcessId
+    // holds; used when several processes share a frame that is evicted
+    void sharePage(int fromProcessId, int toProcessId, uint32_t page);
+
+    // Shares every stored page of the parent with the child
+    void clonePages(int parentId, int childId);
+
+    // Drops one stored page, as when a newer copy is kept elsewhere
+    void releasePage(int processId, uint32_t page);
+    void releaseProcess(int processId);
+
+    // Shrinks the swap file while no more than a quarter of it lies below
+    // the highest slot in use, never under its initial size
+    void trim();
+
+    unsigned int getNumReads() const;
+    unsigned int getNumWrites() const;
+    unsigned int getNumWriteBatches() const;
+    size_t getNumQueuedWrites() const;
+    size_t getNumStoredPages() const;
+    size_t getNumUsedSlots() const;
+    size_t getSlotSize() const;
+    size_t getSwapSize() const;     // bytes currently backing the slots
+
+private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+    static constexpr size_t kMaxSlots = 0x7FFFFFFF;     // the bitmap counts slots in an int
+
+    struct StoredPage {
+        uint32_t firstSlot;
+        uint32_t size;
+    };
+
+    struct PendingWrite {
+        std::vector<uint8_t> data;
+        bool submitted = false;     // a batch is copying it; the buffer no longer changes
+    };
+
+    uint8_t* slotData(uint32_t slot);
+    std::vector<uint32_t> chainSlots(uint32_t slot) const;
+    void copyToSlots(const std::vector<uint32_t>& slots, const uint8_t* data, size_t size);
+    void copyFromSlots(const std::vector<uint32_t>& slots, uint8_t* data, size_t size);
+    size_t chainLength(size_t size) const;
+
+    // Takes enough free slots for size bytes and links them, growing the
+    // file if needed. Every slot starts with one reference.
+    uint32_t allocateChain(size_t size);
+    void retainChain(uint32_t slot);
+    void releaseChain(uint32_t slot);
+    void resizeArea(size_t slots);
+
+    MappedFile swapFile;
+    std::string swapPath;
+    std::vector<uint8_t> memoryArea;    // stands in for the file if it could not be created
+    size_t slotSize;
+    size_t numSlots;                    // slots the file currently holds
+    size_t initialSlots;
+
+    // Transfers hold it shared while copying; moving the mapping holds it
+    // exclusively
+    std::shared_timed_mutex areaMutex;
+
+    FrameBitmap freeSlots;
+    std::vector<uint32_t> refCounts;    // per slot; zero while free
+    std::vector<uint32_t> nextSlot;     // per slot, the rest of its chain
+
+    // Buffered writes by first slot, and the first slots in write order.
+    // An entry freed before its batch is taken is skipped then.
+    std::unordered_map<uint32_t, std::shared_ptr<PendingWrite>> pendingWrites;
+    std::vector<uint32_t> writeQueue;
+    size_t numQueuedWrites;
+
+    std::unordered_map<int, std::unordered_map<uint32_t, StoredPage>> pages;
+    size_t numStoredPages;
+    unsigned int numReads;
+    unsigned int numWrites;
+    unsigned int numWriteBatches;
+};
@@ -0,0 +1,263 @@
+#include "BinaryLog.h"
+#include "LogWriter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+constexpr size_t BinaryLogWriter::kSegmentSize;
+
+namespace {
+
+const size_t kHeaderSize = sizeof(BinaryLogSegmentHeader);
+const size_t kRecordSize = sizeof(BinaryLogRecord);
+
+// String payloads are padded so every record stays 32-byte aligned
+size_t paddedLength(size_t length) {
+    return (length + kRecordSize - 1) / kRecordSize * kRecordSize;
+}
+
+uint64_t toMilliseconds(std::chrono::system_clock::time_point time) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        time.time_since_epoch()).count());
+}
+
+} // namespace
+
+BinaryLogWriter::BinaryLogWriter(const std::string& prefix)
+    : prefix(prefix), used(0), segmentIndex(0), sessionId(0) {}
+
+bool BinaryLogWriter::open() {
+    close();
+    strings.clear();
+    processNames.clear();
+    sessionId = toMilliseconds(std::chrono::system_clock::now());
+
+    // A stale segment 1 would otherwise look like part of this session
+    // until this one grows that far; decoding checks the session ID
+    return openSegment(0);
+}
+
+void BinaryLogWriter::append(const LogRecord& record) {
+    if (!segment.isOpen()) {
+        return;
+    }
+
+    // Records only carry the PID; bind it to a name whenever that changes,
+    // since PIDs are reused after a process is retired
+    uint32_t nameId = intern(record.processName);
+    auto it = processNames.find(record.processId);
+    if (record.header || it == processNames.end() || it->second != nameId) {
+        BinaryLogRecord binding = {};
+        binding.type = BinaryLogFormat::ProcessName;
+        binding.flags = record.header ? BinaryLogFormat::Header : 0;
+        binding.coreId = 0xFFFF;
+        binding.processId = static_cast<uint32_t>(record.processId);
+        binding.timestamp = toMilliseconds(record.time);
+        binding.sequence = record.sequence;
+        binding.messageId = nameId;
+        writeRecord(binding);
+        processNames[record.processId] = nameId;
+    }
+    if (record.header) {
+        return;
+    }
+
+    BinaryLogRecord message = {};
+    message.type = BinaryLogFormat::Message;
+    message.flags = record.hasArgument ? BinaryLogFormat::HasArgument : 0;
+    message.coreId = record.coreId < 0 ? 0xFFFF : static_cast<uint16_t>(record.coreId);
+    message.processId = static_cast<uint32_t>(record.processId);
+    message.timestamp = toMilliseconds(record.time);
+    message.sequence = record.sequence;
+    message.instructionIndex = record.instructionIndex;
+    message.messageId = intern(record.message);
+    message.argument = record.argument;
+    writeRecord(message);
+}
+
+void BinaryLogWriter::flush() {
+    if (!segment.isOpen()) {
+        return;
+    }
+    auto* header = reinterpret_cast<BinaryLogSegmentHeader*>(segment.data());
+    header->usedBytes = used;
+    segment.flush();
+}
+
+void BinaryLogWriter::close() {
+    closeSegment();
+}
+
+uint32_t BinaryLogWriter::intern(const std::string& text) {
+    auto it = strings.find(text);
+    if (it != strings.end()) {
+        return it->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    BinaryLogRecord definition = {};
+    definition.type = BinaryLogFormat::String;
+    definition.coreId = 0xFFFF;
+    definition.messageId = id;
+    definition.argument = static_cast<uint32_t>(text.size());
+    writeRecord(definition, text.data(), text.size());
+    strings.emplace(text, id);
+    return id;
+}
+
+bool BinaryLogWriter::reserve(size_t bytes) {
+    if (segment.isOpen() && used + bytes <= segment.size()) {
+        return true;
+    }
+    if (kHeaderSize + bytes > kSegmentSize) {
+        return false;   // a string longer than a whole segment is not logged
+    }
+    uint32_t next = segment.isOpen() ? segmentIndex + 1 : segmentIndex;
+    closeSegment();
+    return openSegment(next);
+}
+
+bool BinaryLogWriter::openSegment(uint32_t index) {
+    if (!segment.create(BinaryLogDecoder::segmentPath(prefix, index), kSegmentSize)) {
+        return false;
+    }
+    segmentIndex = index;
+
+    BinaryLogSegmentHeader header = {};
+    std::memcpy(header.magic, BinaryLogFormat::kMagic, sizeof(header.magic));
+    header.version = BinaryLogFormat::kVersion;
+    header.sessionId = sessionId;
+    header.usedBytes = kHeaderSize;
+    header.segmentIndex = index;
+    header.recordSize = static_cast<uint32_t>(kRecordSize);
+    std::memcpy(segment.data(), &header, kHeaderSize);
+    used = kHeaderSize;
+    return true;
+}
+
+void BinaryLogWriter::closeSegment() {
+    if (!segment.isOpen()) {
+        return;
+    }
+    flush();
+    segment.close(used);
+}
+
+void BinaryLogWriter::writeRecord(const BinaryLogRecord& record, const void* payload, size_t payloadSize) {
+    size_t bytes = kRecordSize + paddedLength(payloadSize);
+    if (!reserve(bytes)) {
+        return;
+    }
+    uint8_t* target = segment.data() + used;
+    std::memcpy(target, &record, kRecordSize);
+    if (payloadSize > 0) {
+        // The mapping is zero-filled, so the padding needs no writes
+        std::memcpy(target + kRecordSize, payload, payloadSize);
+    }
+    used += bytes;
+}
+
+std::string BinaryLogDecoder::segmentPath(const std::string& prefix, uint32_t index) {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "-%06u.bin", index);
+    return prefix + suffix;
+}
+
+long long BinaryLogDecoder::decode(const std::string& processName, const std::string& prefix) {
+    std::vector<std::string> strings;
+    std::unordered_map<uint32_t, uint32_t> names;  // PID -> name ID
+    std::unordered_set<std::string> started;
+    TextLogFiles output;
+    long long rendered = 0;
+    uint64_t sessionId = 0;
+
+    for (uint32_t index = 0; ; ++index) {
+        MappedFile segment;
+        if (!segment.openReadOnly(segmentPath(prefix, index)) || segment.size() < kHeaderSize) {
+            if (index == 0) return -1;
+            break;
+        }
+
+        BinaryLogSegmentHeader header;
+        std::memcpy(&header, segment.data(), kHeaderSize);
+        if (std::memcmp(header.magic, BinaryLogFormat::kMagic, sizeof(header.magic)) != 0
+            || header.version != BinaryLogFormat::kVersion || header.recordSize != kRecordSize) {
+            if (index == 0) return -1;
+            break;
+        }
+        if (index == 0) {
+            sessionId = header.sessionId;
+        }
+        else if (header.sessionId != sessionId) {
+            break;      // left over from an earlier, longer session
+        }
+
+        size_t end = static_cast<size_t>(header.usedBytes);
+        if (end > segment.size()) end = segment.size();
+
+        for (size_t offset = kHeaderSize; offset + kRecordSize <= end; ) {
+            BinaryLogRecord record;
+            std::memcpy(&record, segment.data() + offset, kRecordSize);
+            offset += kRecordSize;
+
+            if (record.type == BinaryLogFormat::Invalid) {
+                break;
+            }
+            if (record.type == BinaryLogFormat::String) {
+                size_t length = record.argument;
+                if (offset + length > end) break;
+                if (strings.size() <= record.messageId) {
+                    strings.resize(record.messageId + 1);
+                }
+                strings[record.messageId].assign(reinterpret_cast<const char*>(segment.data() + offset), length);
+                offset += paddedLength(length);
+                continue;
+            }
+            if (record.messageId >= strings.size()) {
+                continue;   // corrupt; the string was never defined
+            }
+            if (record.type == BinaryLogFormat::ProcessName) {
+                names[record.processId] = record.messageId;
+            }
+
+            auto nameIt = names.find(record.processId);
+            if (nameIt == names.end()) continue;
+            const std::string& name = strings[nameIt->second];
+            if (!processName.empty() && name != processName) continue;
+
+            bool isHeader = record.type == BinaryLogFormat::ProcessName
+                && (record.flags & BinaryLogFormat::Header) != 0;
+            if (record.type != BinaryLogFormat::Message && !isHeader) continue;
+
+            if (started.insert(name).second && !isHeader) {
+                // Logging was switched on after the process was created;
+                // still start its file over so decoding twice is harmless
+                LogRecord header;
+                header.processName = name;
+                header.header = true;
+                output.write(header);
+            }
+
+            LogRecord text;
+            text.processName = name;
+            text.processId = static_cast<int>(record.processId);
+            text.time = std::chrono::system_clock::time_point(std::chrono::milliseconds(record.timestamp));
+            text.sequence = record.sequence;
+            text.instructionIndex = record.instructionIndex;
+            text.coreId = record.coreId == 0xFFFF ? -1 : record.coreId;
+            text.header = isHeader;
+            if (!isHeader) {
+                text.message = strings[record.messageId];
+                text.hasArgument = (record.flags & BinaryLogFormat::HasArgument) != 0;
+                text.argument = record.argument;
+            }
+            output.write(text);
+            rendered++;
+        }
+    }
+
+    output.closeAll();
+    return rendered;
+}
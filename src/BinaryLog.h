@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "MappedFile.h"
+
+struct LogRecord;
+class TextLogFiles;
+
+// Binary process logs are a session of append-only segment files,
+// <prefix>-000000.bin, <prefix>-000001.bin, ... Each segment starts with a
+// BinaryLogSegmentHeader followed by 32-byte records. Strings (messages
+// and process names) are interned: the first use writes a String record
+// carrying the text, and later records refer to it by ID, so decoding
+// always starts from the session's first segment. Messages keep the
+// process name placeholder, so one PRINT line shared by many processes is
+// a single string; the decoder fills the name in.
+namespace BinaryLogFormat {
+    constexpr char kMagic[4] = { 'O', 'S', 'L', 'G' };
+    constexpr uint32_t kVersion = 1;
+
+    enum RecordType : uint8_t {
+        Invalid = 0,
+        String = 1,         // defines messageId; argument is the text length
+        ProcessName = 2,    // binds processId to the name string messageId
+        Message = 3
+    };
+
+    enum RecordFlags : uint8_t {
+        HasArgument = 0x1,  // Message: argument is printed after the text
+        Header = 0x2        // ProcessName: the process's log starts over
+    };
+}
+
+struct BinaryLogSegmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sessionId;
+    uint64_t usedBytes;     // header and records written so far
+    uint32_t segmentIndex;
+    uint32_t recordSize;
+    uint8_t reserved[32];
+};
+
+struct BinaryLogRecord {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t coreId;            // 0xFFFF when not logged from a core
+    uint32_t processId;
+    uint64_t timestamp;         // milliseconds since the epoch
+    uint32_t sequence;
+    uint32_t instructionIndex;
+    uint32_t messageId;
+    uint32_t argument;
+};
+
+static_assert(sizeof(BinaryLogSegmentHeader) == 64, "segment header layout");
+static_assert(sizeof(BinaryLogRecord) == 32, "record layout");
+
+// Appends log records to preallocated, memory-mapped segments. Only the
+// log writer thread calls it.
+class BinaryLogWriter {
+public:
+    static constexpr size_t kSegmentSize = 16 * 1024 * 1024;
+
+    explicit BinaryLogWriter(const std::string& prefix = "process-log");
+
+    // Starts a new session, overwriting segment 0
+    bool open();
+    void append(const LogRecord& record);
+    void flush();   // publishes the used length to readers
+    void close();   // trims the last segment to its used length
+
+private:
+    uint32_t intern(const std::string& text);
+    bool reserve(size_t bytes);
+    bool openSegment(uint32_t index);
+    void closeSegment();
+    void writeRecord(const BinaryLogRecord& record, const void* payload = nullptr, size_t payloadSize = 0);
+
+    std::string prefix;
+    MappedFile segment;
+    size_t used;
+    uint32_t segmentIndex;
+    uint64_t sessionId;
+
+    std::unordered_map<std::string, uint32_t> strings;
+    std::unordered_map<int, uint32_t> processNames;    // PID -> name ID last written
+};
+
+// Renders a binary log session back into per-process text files in the
+// same format the text logger writes
+class BinaryLogDecoder {
+public:
+    // Decodes every process, or only processName when it is not empty.
+    // Returns the number of records rendered, or -1 if no session exists.
+    static long long decode(const std::string& processName = "", const std::string& prefix = "process-log");
+
+    static std::string segmentPath(const std::string& prefix, uint32_t index);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bit-scan helpers over 64-bit words. Callers must not pass 0 to the
+// count functions.
+namespace BitOps {
+
+inline unsigned int countTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+#endif
+}
+
+inline unsigned int popCount(uint64_t word) {
+#ifdef _MSC_VER
+    return static_cast<unsigned int>(__popcnt64(word));
+#else
+    return static_cast<unsigned int>(__builtin_popcountll(word));
+#endif
+}
+
+// Mask of the bits at or above position bit (bit < 64)
+inline uint64_t maskFrom(unsigned int bit) {
+    return ~uint64_t(0) << bit;
+}
+
+} // namespace BitOps
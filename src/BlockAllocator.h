@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class Process;
+
+// Placement of whole-process blocks in the flat memory model. Every
+// process owns at most one block.
+class BlockAllocator {
+public:
+    static constexpr size_t kNoSpace = SIZE_MAX;
+
+    virtual ~BlockAllocator() = default;
+
+    // Returns the offset of the new block, or kNoSpace if nothing fits
+    virtual size_t allocate(Process* owner, size_t size) = 0;
+
+    // Frees the owner's block, reporting the offset and size it was given.
+    // Returns false if the owner has no block.
+    virtual bool release(Process* owner, size_t& offset, size_t& size) = 0;
+    virtual bool find(const Process* owner, size_t& offset, size_t& size) const = 0;
+
+    virtual size_t getUsed() const = 0;         // bytes held by blocks, rounding included
+    virtual size_t getRequested() const = 0;    // bytes the owners asked for
+    virtual size_t getNumFreeBlocks() const = 0;
+    virtual size_t getLargestFreeBlock() const = 0;
+    virtual const char* getName() const = 0;
+
+    // Slides one block down into the lowest free block and reports the move
+    // so the caller can copy the contents. Returns false once free space is
+    // a single block at the top, or if this allocator cannot move blocks.
+    virtual bool compactStep(Process*&, size_t&, size_t&, size_t&) { return false; }
+
+    // Allocated blocks in address order, with the size each owner asked for
+    virtual void forEachAllocation(const std::function<void(Process*, size_t offset, size_t size)>& visitor) const = 0;
+};
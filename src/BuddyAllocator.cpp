@@ -0,0 +1,159 @@
+#include "BuddyAllocator.h"
+
+constexpr unsigned int BuddyAllocator::kMinOrder;
+constexpr unsigned int BuddyAllocator::kMaxLeafOrders;
+
+BuddyAllocator::BuddyAllocator(size_t capacity)
+    : capacity(0), minOrder(kMinOrder), numLevels(0), numFree(0), used(0), requested(0) {
+    // Only the largest power of two that fits is managed
+    unsigned int maxOrder = 0;
+    while (capacity >> (maxOrder + 1)) {
+        maxOrder++;
+    }
+    if (capacity == 0) {
+        return;
+    }
+    this->capacity = size_t(1) << maxOrder;
+
+    if (minOrder > maxOrder) {
+        minOrder = maxOrder;
+    }
+    if (maxOrder - minOrder > kMaxLeafOrders) {
+        minOrder = maxOrder - kMaxLeafOrders;
+    }
+    numLevels = maxOrder - minOrder + 1;
+
+    freeLists.resize(numLevels);
+    pairBits.resize(numLevels - 1);
+    for (unsigned int level = 0; level + 1 < numLevels; ++level) {
+        size_t numPairs = this->capacity >> (minOrder + level + 1);
+        pairBits[level].assign((numPairs + 63) / 64, 0);
+    }
+    freeLists[numLevels - 1].insert(0);
+    numFree = 1;
+}
+
+size_t BuddyAllocator::allocate(Process* owner, size_t size) {
+    if (size == 0 || size > capacity || ownerIndex.count(owner) != 0) {
+        return kNoSpace;
+    }
+    unsigned int level = 0;
+    while (blockSize(level) < size) {
+        level++;
+    }
+
+    // The smallest free block at or above the wanted order
+    unsigned int from = level;
+    while (from < numLevels && freeLists[from].empty()) {
+        from++;
+    }
+    if (from == numLevels) {
+        return kNoSpace;
+    }
+
+    size_t offset = *freeLists[from].begin();
+    freeLists[from].erase(freeLists[from].begin());
+    numFree--;
+    if (from + 1 < numLevels) {
+        togglePair(from, offset);
+    }
+
+    // Split down, keeping the low half and freeing each high half
+    while (from > level) {
+        from--;
+        size_t upper = offset + blockSize(from);
+        freeLists[from].insert(upper);
+        numFree++;
+        togglePair(from, upper);
+    }
+
+    allocations[offset] = { owner, size, level };
+    ownerIndex[owner] = offset;
+    used += blockSize(level);
+    requested += size;
+    return offset;
+}
+
+bool BuddyAllocator::release(Process* owner, size_t& offset, size_t& size) {
+    auto it = ownerIndex.find(owner);
+    if (it == ownerIndex.end()) {
+        return false;
+    }
+    offset = it->second;
+    const Allocation& allocation = allocations[offset];
+    size = allocation.requested;
+    unsigned int level = allocation.level;
+    used -= blockSize(level);
+    requested -= size;
+    allocations.erase(offset);
+    ownerIndex.erase(it);
+
+    size_t block = offset;
+    while (level + 1 < numLevels) {
+        if (togglePair(level, block)) {
+            break;  // the buddy is in use
+        }
+        // Both halves are free: take the buddy off its list and move up.
+        // The pair bit stays clear, as neither half exists on its own now.
+        size_t buddy = block ^ blockSize(level);
+        freeLists[level].erase(buddy);
+        numFree--;
+        block &= ~blockSize(level);
+        level++;
+    }
+    freeLists[level].insert(block);
+    numFree++;
+    return true;
+}
+
+bool BuddyAllocator::find(const Process* owner, size_t& offset, size_t& size) const {
+    auto it = ownerIndex.find(owner);
+    if (it == ownerIndex.end()) {
+        return false;
+    }
+    offset = it->second;
+    size = allocations.at(offset).requested;
+    return true;
+}
+
+size_t BuddyAllocator::getUsed() const {
+    return used;
+}
+
+size_t BuddyAllocator::getRequested() const {
+    return requested;
+}
+
+size_t BuddyAllocator::getNumFreeBlocks() const {
+    return numFree;
+}
+
+size_t BuddyAllocator::getLargestFreeBlock() const {
+    for (unsigned int level = numLevels; level-- > 0; ) {
+        if (!freeLists[level].empty()) {
+            return blockSize(level);
+        }
+    }
+    return 0;
+}
+
+const char* BuddyAllocator::getName() const {
+    return "buddy";
+}
+
+void BuddyAllocator::forEachAllocation(const std::function<void(Process*, size_t, size_t)>& visitor) const {
+    for (const auto& pair : allocations) {
+        visitor(pair.second.owner, pair.first, pair.second.requested);
+    }
+}
+
+size_t BuddyAllocator::blockSize(unsigned int level) const {
+    return size_t(1) << (minOrder + level);
+}
+
+bool BuddyAllocator::togglePair(unsigned int level, size_t offset) {
+    size_t pair = offset >> (minOrder + level + 1);
+    uint64_t& word = pairBits[level][pair / 64];
+    word ^= uint64_t(1) << (pair % 64);
+    return (word >> (pair % 64)) & 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "BlockAllocator.h"
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Binary buddy allocator over a power-of-two region. Requests are rounded
+// up to a power-of-two block; each order keeps its free blocks in an
+// address-ordered list, and one bit per buddy pair per order records
+// whether exactly one of the two is free, so freeing a block learns from a
+// single bit flip whether its buddy can be merged. Splitting and
+// coalescing walk at most one step per order, O(log n) overall.
+class BuddyAllocator : public BlockAllocator {
+public:
+    // The smallest block is 64 bytes, or larger when the region would
+    // otherwise need more than about a million of them
+    static constexpr unsigned int kMinOrder = 6;
+    static constexpr unsigned int kMaxLeafOrders = 20;
+
+    explicit BuddyAllocator(size_t capacity);
+
+    size_t allocate(Process* owner, size_t size) override;
+    bool release(Process* owner, size_t& offset, size_t& size) override;
+    bool find(const Process* owner, size_t& offset, size_t& size) const override;
+
+    size_t getUsed() const override;
+    size_t getRequested() const override;
+    size_t getNumFreeBlocks() const override;
+    size_t getLargestFreeBlock() const override;
+    const char* getName() const override;
+
+    void forEachAllocation(const std::function<void(Process*, size_t, size_t)>& visitor) const override;
+
+private:
+    struct Allocation {
+        Process* owner;
+        size_t requested;
+        unsigned int level;
+    };
+
+    size_t blockSize(unsigned int level) const;
+
+    // Flips the pair bit of the block at offset on level; returns the new
+    // value, which is 1 when exactly one of the pair is free
+    bool togglePair(unsigned int level, size_t offset);
+
+    size_t capacity;            // a power of two
+    unsigned int minOrder;
+    unsigned int numLevels;     // level 0 is the smallest block, the last is the whole region
+
+    std::vector<std::set<size_t>> freeLists;        // per level, by offset
+    std::vector<std::vector<uint64_t>> pairBits;    // per level below the top
+    size_t numFree;
+
+    size_t used;
+    size_t requested;
+    std::unordered_map<const Process*, size_t> ownerIndex;     // owner -> offset
+    std::map<size_t, Allocation> allocations;                  // offset -> block
+};
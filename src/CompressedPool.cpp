@@ -0,0 +1,291 @@
+#include "CompressedPool.h"
+#include <algorithm>
+#include <cstring>
+
+constexpr size_t CompressedPool::kMaxStoredPercent;
+
+namespace {
+    // The codec writes a run of literals as a token holding the run length
+    // less one, followed by the bytes. A token with the high bit set is a
+    // match instead: its low bits hold the length less kMinMatch and two
+    // bytes after it the distance back to copy from.
+    constexpr size_t kMinMatch = 4;
+    constexpr size_t kMaxMatch = 0x7F + kMinMatch;
+    constexpr size_t kMaxLiterals = 0x80;
+    constexpr size_t kMaxDistance = 0xFFFF;
+    constexpr size_t kMaxHashSize = 4096;
+    constexpr uint32_t kNoPosition = UINT32_MAX;
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+CompressedPool::CompressedPool()
+    : capacity(0), usedBytes(0), storedBytes(0), numHits(0), numRejects(0), numSpills(0) {}
+
+void CompressedPool::initialize(size_t capacity) {
+    this->capacity = capacity;
+    entries.clear();
+    index.clear();
+    usedBytes = 0;
+    storedBytes = 0;
+    numHits = 0;
+    numRejects = 0;
+    numSpills = 0;
+}
+
+bool CompressedPool::isEnabled() const {
+    return capacity > 0;
+}
+
+bool CompressedPool::storePage(int processId, uint32_t page, const uint8_t* data, size_t size, const SpillVisitor& spill) {
+    dropOwner(processId, page);
+    if (capacity == 0 || size == 0) {
+        return false;
+    }
+
+    Entry entry;
+    entry.page = page;
+    entry.size = static_cast<uint32_t>(size);
+    entry.sameFilled = std::all_of(data + 1, data + size, [data](uint8_t byte) { return byte == data[0]; });
+    if (entry.sameFilled) {
+        entry.data.assign(1, data[0]);
+    }
+    else if (!compress(data, size, entry.data, size * kMaxStoredPercent / 100)) {
+        numRejects++;
+        return false;
+    }
+    if (entry.data.size() > capacity) {
+        numRejects++;
+        return false;
+    }
+
+    while (usedBytes + entry.data.size() > capacity) {
+        spillOldest(spill);
+    }
+    entry.owners.push_back(processId);
+    usedBytes += entry.data.size();
+    storedBytes += size;
+    entries.push_back(std::move(entry));
+    index[processId][page] = std::prev(entries.end());
+    return true;
+}
+
+bool CompressedPool::loadPage(int processId, uint32_t page, uint8_t* data, size_t size) {
+    auto processIt = index.find(processId);
+    if (processIt == index.end()) {
+        return false;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end() || !decompress(*it->second, data, size)) {
+        return false;
+    }
+    numHits++;
+    return true;
+}
+
+bool CompressedPool::sharePage(int fromProcessId, int toProcessId, uint32_t page) {
+    dropOwner(toProcessId, page);
+    auto processIt = index.find(fromProcessId);
+    if (processIt == index.end()) {
+        return false;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end()) {
+        return false;
+    }
+    EntryList::iterator entry = it->second;
+    entry->owners.push_back(toProcessId);
+    index[toProcessId][page] = entry;
+    return true;
+}
+
+void CompressedPool::clonePages(int parentId, int childId) {
+    auto processIt = index.find(parentId);
+    if (processIt == index.end()) {
+        return;
+    }
+    releaseProcess(childId);
+    // Element references survive the rehash an insert can trigger
+    const auto& parentPages = processIt->second;
+    for (const auto& pair : parentPages) {
+        pair.second->owners.push_back(childId);
+    }
+    index[childId] = parentPages;
+}
+
+void CompressedPool::releaseProcess(int processId) {
+    auto it = index.find(processId);
+    if (it == index.end()) {
+        return;
+    }
+    for (const auto& pair : it->second) {
+        std::vector<int>& owners = pair.second->owners;
+        owners.erase(std::find(owners.begin(), owners.end(), processId));
+        if (owners.empty()) {
+            dropEntry(pair.second);
+        }
+    }
+    index.erase(it);
+}
+
+size_t CompressedPool::getCapacity() const {
+    return capacity;
+}
+
+size_t CompressedPool::getUsedBytes() const {
+    return usedBytes;
+}
+
+size_t CompressedPool::getStoredBytes() const {
+    return storedBytes;
+}
+
+size_t CompressedPool::getNumStoredPages() const {
+    return entries.size();
+}
+
+unsigned int CompressedPool::getNumHits() const {
+    return numHits;
+}
+
+unsigned int CompressedPool::getNumRejects() const {
+    return numRejects;
+}
+
+unsigned int CompressedPool::getNumSpills() const {
+    return numSpills;
+}
+
+bool CompressedPool::compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t limit) {
+    out.clear();
+    size_t hashSize = 16;
+    while (hashSize < size && hashSize < kMaxHashSize) {
+        hashSize <<= 1;
+    }
+    hashTable.assign(hashSize, kNoPosition);
+
+    size_t literalStart = 0;
+    auto emitLiterals = [&](size_t end) {
+        while (literalStart < end) {
+            size_t run = std::min(kMaxLiterals, end - literalStart);
+            if (out.size() + 1 + run > limit) {
+                return false;
+            }
+            out.push_back(static_cast<uint8_t>(run - 1));
+            out.insert(out.end(), data + literalStart, data + literalStart + run);
+            literalStart += run;
+        }
+        return true;
+    };
+
+    size_t position = 0;
+    while (position + kMinMatch <= size) {
+        uint32_t value = read32(data + position);
+        uint32_t& slot = hashTable[((value * 2654435761u) >> 16) & (hashSize - 1)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(position);
+        if (candidate == kNoPosition || position - candidate > kMaxDistance || read32(data + candidate) != value) {
+            position++;
+            continue;
+        }
+
+        // Matches may run into the bytes they produce, which encodes runs
+        size_t length = kMinMatch;
+        while (position + length < size && length < kMaxMatch && data[candidate + length] == data[position + length]) {
+            length++;
+        }
+        if (!emitLiterals(position) || out.size() + 3 > limit) {
+            return false;
+        }
+        size_t distance = position - candidate;
+        out.push_back(static_cast<uint8_t>(0x80 | (length - kMinMatch)));
+        out.push_back(static_cast<uint8_t>(distance & 0xFF));
+        out.push_back(static_cast<uint8_t>(distance >> 8));
+        position += length;
+        literalStart = position;
+    }
+    return emitLiterals(size);
+}
+
+bool CompressedPool::decompress(const Entry& entry, uint8_t* data, size_t size) {
+    size_t stored = std::min<size_t>(size, entry.size);
+    if (entry.sameFilled) {
+        std::memset(data, entry.data[0], stored);
+        std::memset(data + stored, 0, size - stored);
+        return true;
+    }
+
+    const std::vector<uint8_t>& in = entry.data;
+    size_t input = 0;
+    size_t output = 0;
+    while (input < in.size() && output < stored) {
+        uint8_t token = in[input++];
+        if (token & 0x80) {
+            if (input + 2 > in.size()) {
+                return false;
+            }
+            size_t length = std::min<size_t>((token & 0x7F) + kMinMatch, stored - output);
+            size_t distance = in[input] | (static_cast<size_t>(in[input + 1]) << 8);
+            input += 2;
+            if (distance == 0 || distance > output) {
+                return false;
+            }
+            // Byte by byte, since the source may overlap what is being written
+            for (size_t i = 0; i < length; ++i, ++output) {
+                data[output] = data[output - distance];
+            }
+        }
+        else {
+            size_t run = token + 1;
+            if (input + run > in.size()) {
+                return false;
+            }
+            run = std::min(run, stored - output);
+            std::memcpy(data + output, in.data() + input, run);
+            input += token + 1;
+            output += run;
+        }
+    }
+    std::memset(data + output, 0, size - output);
+    return output == stored;
+}
+
+void CompressedPool::dropOwner(int processId, uint32_t page) {
+    auto processIt = index.find(processId);
+    if (processIt == index.end()) {
+        return;
+    }
+    auto it = processIt->second.find(page);
+    if (it == processIt->second.end()) {
+        return;
+    }
+    EntryList::iterator entry = it->second;
+    processIt->second.erase(it);
+    entry->owners.erase(std::find(entry->owners.begin(), entry->owners.end(), processId));
+    if (entry->owners.empty()) {
+        dropEntry(entry);
+    }
+}
+
+void CompressedPool::dropEntry(EntryList::iterator entry) {
+    usedBytes -= entry->data.size();
+    storedBytes -= entry->size;
+    entries.erase(entry);
+}
+
+void CompressedPool::spillOldest(const SpillVisitor& spill) {
+    EntryList::iterator oldest = entries.begin();
+    spillBuffer.resize(oldest->size);
+    if (decompress(*oldest, spillBuffer.data(), spillBuffer.size())) {
+        spill(oldest->owners, oldest->page, spillBuffer.data(), spillBuffer.size());
+    }
+    for (int owner : oldest->owners) {
+        index[owner].erase(oldest->page);
+    }
+    numSpills++;
+    dropEntry(oldest);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// A bounded pool of compressed pages kept in host memory in front of the
+// swap file. A page filled with a single byte value is stored as that
+// byte. Any other page goes through a small LZ77 codec and is turned away
+// if it does not shrink to kMaxStoredPercent of its size. Once the pool is
+// full, the pages stored longest ago are handed to a spill callback to go
+// to the swap file.
+//
+// Like BackingStore, pages are keyed by process ID and virtual page
+// number. One compressed copy can belong to several processes: forks share
+// their parent's copies, and a frame shared by several processes is stored
+// once. The pool has no lock of its own; MemoryManager holds its lock
+// around every call.
+class CompressedPool {
+public:
+    static constexpr size_t kMaxStoredPercent = 75;
+
+    // Receives a page leaving the pool for the swap file, with every
+    // process that holds it
+    using SpillVisitor = std::function<void(const std::vector<int>& processIds, uint32_t page,
+        const uint8_t* data, size_t size)>;
+
+    CompressedPool();
+
+    // Drops every stored page. A capacity of zero disables the pool.
+    void initialize(size_t capacity);
+    bool isEnabled() const;
+
+    // Compresses the page into the pool, spilling older pages until it
+    // fits. Returns false if the pool is disabled or the page does not
+    // compress well enough; any older copy of the page is dropped either
+    // way.
+    bool storePage(int processId, uint32_t page, const uint8_t* data, size_t size, const SpillVisitor& spill);
+
+    // Decompresses a stored page into data. The page stays in the pool,
+    // so a clean page evicted again needs no new copy.
+    bool loadPage(int processId, uint32_t page, uint8_t* data, size_t size);
+
+    // Gives toProcessId the copy fromProcessId holds. Returns false, after
+    // dropping any older copy toProcessId held, if there is none.
+    bool sharePage(int fromProcessId, int toProcessId, uint32_t page);
+
+    // Shares every pooled page of the parent with the child
+    void clonePages(int parentId, int childId);
+
+    void releaseProcess(int processId);
+
+    size_t getCapacity() const;
+    size_t getUsedBytes() const;            // compressed bytes held
+    size_t getStoredBytes() const;          // the same pages uncompressed
+    size_t getNumStoredPages() const;
+    unsigned int getNumHits() const;
+    unsigned int getNumRejects() const;
+    unsigned int getNumSpills() const;
+
+private:
+    struct Entry {
+        uint32_t page;
+        uint32_t size;              // uncompressed
+        bool sameFilled;            // data is the one byte the page is filled with
+        std::vector<uint8_t> data;
+        std::vector<int> owners;
+    };
+    using EntryList = std::list<Entry>;
+
+    // Fails once the output would exceed limit bytes
+    bool compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t limit);
+    static bool decompress(const Entry& entry, uint8_t* data, size_t size);
+
+    void dropOwner(int processId, uint32_t page);
+    void dropEntry(EntryList::iterator entry);
+    void spillOldest(const SpillVisitor& spill);
+
+    size_t capacity;
+    size_t usedBytes;
+    size_t storedBytes;
+
+    EntryList entries;      // oldest first
+    std::unordered_map<int, std::unordered_map<uint32_t, EntryList::iterator>> index;
+
+    std::vector<uint32_t> hashTable;    // compressor scratch
+    std::vector<uint8_t> spillBuffer;
+
+    unsigned int numHits;
+    unsigned int numRejects;
+    unsigned int numSpills;
+};
@@ -27,7 +27,13 @@ Config::Config()
     maxOverallMem(512),
     memPerFrame(256),
     minMemPerProc(512),
-    maxMemPerProc(512) {
+    maxMemPerProc(512),
+    maxFinishedProcesses(1000),
+    finishedProcessTtl(0),
+    memAllocFit("first"),
+    memAllocator("list"),
+    pageReplacement("fifo"),
+    swapPoolSize(0) {
 }
 
 bool Config::loadConfig(const std::string& filename) {
@@ -133,6 +139,42 @@ bool Config::loadConfig(const std::string& filename) {
                 return false;
             }
         }
+        else if (paramName == "max-finished-processes") {
+            iss >> maxFinishedProcesses;
+        }
+        else if (paramName == "finished-process-ttl") {
+            iss >> finishedProcessTtl;
+        }
+        else if (paramName == "mem-alloc-fit") {
+            std::string fitValue;
+            iss >> fitValue;
+            memAllocFit = stripQuotes(fitValue);
+            if (memAllocFit != "first" && memAllocFit != "best" && memAllocFit != "worst") {
+                std::cerr << "Invalid mem-alloc-fit in " << filename << ": must be 'first', 'best' or 'worst'" << std::endl;
+                return false;
+            }
+        }
+        else if (paramName == "mem-allocator") {
+            std::string allocatorValue;
+            iss >> allocatorValue;
+            memAllocator = stripQuotes(allocatorValue);
+            if (memAllocator != "list" && memAllocator != "buddy") {
+                std::cerr << "Invalid mem-allocator in " << filename << ": must be 'list' or 'buddy'" << std::endl;
+                return false;
+            }
+        }
+        else if (paramName == "page-replacement") {
+            std::string policyValue;
+            iss >> policyValue;
+            pageReplacement = stripQuotes(policyValue);
+            if (pageReplacement != "fifo" && pageReplacement != "lru" && pageReplacement != "clock" && pageReplacement != "arc") {
+                std::cerr << "Invalid page-replacement in " << filename << ": must be 'fifo', 'lru', 'clock' or 'arc'" << std::endl;
+                return false;
+            }
+        }
+        else if (paramName == "swap-pool-size") {
+            iss >> swapPoolSize;
+        }
         else {
             std::cerr << "Unknown parameter in " << filename << ": " << paramName << std::endl;
             return false;
@@ -194,4 +236,28 @@ unsigned int Config::getMinMemPerProc() const {
 
 unsigned int Config::getMaxMemPerProc() const {
     return maxMemPerProc;
+}
+
+unsigned int Config::getMaxFinishedProcesses() const {
+    return maxFinishedProcesses;
+}
+
+unsigned int Config::getFinishedProcessTtl() const {
+    return finishedProcessTtl;
+}
+
+const std::string& Config::getMemAllocFit() const {
+    return memAllocFit;
+}
+
+const std::string& Config::getMemAllocator() const {
+    return memAllocator;
+}
+
+const std::string& Config::getPageReplacement() const {
+    return pageReplacement;
+}
+
+unsigned int Config::getSwapPoolSize() const {
+    return swapPoolSize;
 }
\ No newline at end of file
@@ -19,6 +19,12 @@ public:
     unsigned int getMemPerFrame() const;
     unsigned int getMinMemPerProc() const;
     unsigned int getMaxMemPerProc() const;
+    unsigned int getMaxFinishedProcesses() const;
+    unsigned int getFinishedProcessTtl() const;
+    const std::string& getMemAllocFit() const;
+    const std::string& getMemAllocator() const;
+    const std::string& getPageReplacement() const;
+    unsigned int getSwapPoolSize() const;
 
 private:
     Config();
@@ -40,4 +46,10 @@ private:
     unsigned int memPerFrame;
     unsigned int minMemPerProc;
     unsigned int maxMemPerProc;
+    unsigned int maxFinishedProcesses;   // 0 keeps every finished process
+    unsigned int finishedProcessTtl;     // seconds; 0 disables age-based retirement
+    std::string memAllocFit;             // flat-memory placement: first, best or worst
+    std::string memAllocator;            // flat-memory allocator: list or buddy
+    std::string pageReplacement;         // paging victim choice: fifo, lru, clock or arc
+    unsigned int swapPoolSize;           // bytes of compressed pages held before swapping; 0 disables
 };
\ No newline at end of file
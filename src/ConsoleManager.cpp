@@ -1,17 +1,23 @@
 #include "ConsoleManager.h"
+#include "InstructionGenerator.h"
 #include "MainConsole.h"
-#include "PrintCommand.h"
 #include "SchedulerFirstComeFirstServe.h"
 #include "SchedulerRoundRobin.h"
 #include "Screen.h"
+#include <algorithm>
 #include <chrono>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <thread>
+#include <unordered_set>
+
+constexpr unsigned int ConsoleManager::kRetentionIntervalCycles;
 
 ConsoleManager::ConsoleManager()
-	: testing(false), initialized(false), scheduler(nullptr), cpuCycles(0), cpuCycleRunning(false) {
+	: processTable(PidAllocator::kMaxPid), processHolds(0), cpuCycles(0), cpuCycleRunning(false), scheduler(nullptr),
+	testing(false), consoleOutput(ioMutex), initialized(false) {
 	mainConsole = new MainConsole(*this);
 }
 
@@ -20,11 +26,16 @@ ConsoleManager::~ConsoleManager() {
 	stopCpuCycleCounter();
 	if (scheduler) {
 		scheduler->stop();
+		// Page-in completions hand processes back to the scheduler
+		memoryManager.waitForSwapIo();
 		delete scheduler;
 	}
 	delete mainConsole;
-	for (auto& pair : processes) {
-		delete pair.second;
+	for (Process* process : processTable.snapshot()) {
+		delete process;
+	}
+	for (Process* process : retiredProcesses) {
+		delete process;
 	}
 }
 
@@ -35,9 +46,20 @@ bool ConsoleManager::initialize() {
 		return false;
 	}
 
+	FitPolicy fitPolicy = FitPolicy::First;
+	if (config.getMemAllocFit() == "best") {
+		fitPolicy = FitPolicy::Best;
+	}
+	else if (config.getMemAllocFit() == "worst") {
+		fitPolicy = FitPolicy::Worst;
+	}
 	memoryManager.initialize(
 		config.getMaxOverallMem(),
-		config.getMemPerFrame()
+		config.getMemPerFrame(),
+		fitPolicy,
+		config.getMemAllocator() == "buddy",
+		config.getPageReplacement(),
+		config.getSwapPoolSize()
 	);
 
 	if (config.getSchedulerType() == "fcfs") {
@@ -50,6 +72,9 @@ bool ConsoleManager::initialize() {
 		std::cerr << "Unknown scheduler type in configuration." << std::endl;
 		return false;
 	}
+	memoryManager.setPageInHandler([this](Process* process) {
+		scheduler->addProcess(process);
+	});
 
 	startScheduler();
 	startCpuCycleCounter();
@@ -87,28 +112,100 @@ void ConsoleManager::cpuCycleLoop() {
 			if (!cpuCycleRunning) break;
 		}
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
-		cpuCycles++;
+		wakeSleepingProcesses();
+		if (++cpuCycles % kRetentionIntervalCycles == 0) {
+			retireFinishedProcesses();
+		}
+	}
+}
+
+void ConsoleManager::sleepProcess(Process* process, unsigned int ticks) {
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	sleepingProcesses.emplace(cpuCycles.load() + ticks, process);
+}
+
+void ConsoleManager::wakeSleepingProcesses() {
+	std::vector<Process*> woken;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		unsigned int now = cpuCycles.load();
+		auto end = sleepingProcesses.upper_bound(now);
+		for (auto it = sleepingProcesses.begin(); it != end; ++it) {
+			woken.push_back(it->second);
+		}
+		sleepingProcesses.erase(sleepingProcesses.begin(), end);
+	}
+	if (!woken.empty() && scheduler) {
+		scheduler->addProcesses(woken);
+	}
+}
+
+void ConsoleManager::retireFinishedProcesses() {
+	std::lock_guard<std::mutex> lock(retentionMutex);
+	if (!scheduler) return;
+
+	// Free what earlier passes retired, unless a screen picked it up since.
+	// While any hold is alive its owner may still use one of them.
+	if (processHolds.load() == 0) {
+		std::vector<Process*> stillAttached;
+		for (Process* process : retiredProcesses) {
+			if (process->isAttached()) {
+				stillAttached.push_back(process);
+			}
+			else {
+				pidAllocator.release(process->getId());
+				delete process;
+			}
+		}
+		retiredProcesses.swap(stillAttached);
+	}
+
+	Config& config = Config::getInstance();
+	unsigned int maxFinished = config.getMaxFinishedProcesses();
+	unsigned int ttl = config.getFinishedProcessTtl();
+
+	std::vector<Process*> finished;
+	for (Process* process : processTable.snapshot()) {
+		if (process->isCompleted() && !process->isAttached()) {
+			finished.push_back(process);
+		}
+	}
+
+	// Oldest first; anything past the count limit or the age limit goes
+	std::sort(finished.begin(), finished.end(), [](const Process* a, const Process* b) {
+		return a->getFinishTime() < b->getFinishTime();
+	});
+	size_t excess = (maxFinished > 0 && finished.size() > maxFinished) ? finished.size() - maxFinished : 0;
+	std::time_t now = std::time(nullptr);
+
+	std::vector<Process*> retiring;
+	for (size_t i = 0; i < finished.size(); ++i) {
+		Process* process = finished[i];
+		bool expired = ttl > 0 && now - process->getFinishTime() >= static_cast<std::time_t>(ttl);
+		if (i >= excess && !expired) continue;
+
+		processTable.remove(process);
+		processArchive.add(ProcessSummary::fromProcess(*process));
+		retiring.push_back(process);
+	}
+
+	if (!retiring.empty()) {
+		scheduler->removeProcesses(retiring);
+		retiredProcesses.insert(retiredProcesses.end(), retiring.begin(), retiring.end());
 	}
 }
 
 void ConsoleManager::safePrint(const std::string& message) {
-	std::lock_guard<std::mutex> lock(ioMutex);
-	// Move to new line and print message
-	std::cout << message << std::endl;
-	// Reprint the prompt
-	std::cout << currentPrompt;
-	std::cout.flush();
+	// Queued for the output thread, which reprints the prompt after it
+	consoleOutput.print(message);
 }
 
 void ConsoleManager::printPrompt() {
-	std::lock_guard<std::mutex> lock(ioMutex);
-	std::cout << currentPrompt;
-	std::cout.flush();
+	consoleOutput.printPrompt();
 }
 
 void ConsoleManager::setCurrentPrompt(const std::string& prompt) {
-	std::lock_guard<std::mutex> lock(ioMutex);
-	currentPrompt = prompt;
+	consoleOutput.setPrompt(prompt);
 }
 
 
@@ -121,76 +218,142 @@ void ConsoleManager::switchToMainConsole() {
 	mainConsole->run();
 }
 
-void ConsoleManager::switchToScreen(Process* process) {
+void ConsoleManager::switchToScreen(const std::string& name) {
+	Process* process;
+	{
+		// Attached processes are never freed, so the hold can end here
+		ProcessHold hold(*this);
+		process = getProcess(name);
+		if (process == nullptr) return;
+		process->setAttached(true);
+	}
 	system("CLS");
 	Screen screen(*this, process);
 	screen.run();
+	process->setAttached(false);
 }
 
-bool ConsoleManager::createProcess(const std::string& name) {
-	std::lock_guard<std::mutex> lock(processMutex);
-	if (processes.find(name) == processes.end()) {
-		Process* process = new Process(name);
+bool ConsoleManager::createProcess(const std::string& name, std::shared_ptr<Program> program, unsigned int memSize) {
+	// Claim the name first; memory allocation runs without any table lock held
+	if (!processTable.reserve(name)) {
+		std::cout << "Process with name '" << name << "' already exists.\n";
+		return false;
+	}
 
-		// Set memory size for the process
-		Config& config = Config::getInstance();
-		unsigned int minMem = config.getMinMemPerProc();
-		unsigned int maxMem = config.getMaxMemPerProc();
-		unsigned int memSize = minMem + rand() % (maxMem - minMem + 1);
+	int pid = pidAllocator.allocate();
+	if (pid < 0) {
+		std::cout << "Cannot create process '" << name << "': no free process IDs.\n";
+		processTable.release(name);
+		return false;
+	}
+	Process* process = new Process(name, pid);
 
-		// Validate memory size against total available memory
-		if (memSize > config.getMaxOverallMem()) {
-			std::cout << "Process memory requirement (" << memSize
-				<< " KB) exceeds system memory ("
-				<< config.getMaxOverallMem() << " KB).\n";
-			delete process;
-			return false;
-		}
+	// Set memory size for the process
+	Config& config = Config::getInstance();
+	if (memSize == 0) {
+		memSize = randomMemorySize();
+	}
 
-		process->setMemorySize(memSize);
+	// Validate memory size against total available memory
+	if (memSize > config.getMaxOverallMem()) {
+		std::cout << "Process memory requirement (" << memSize
+			<< " KB) exceeds system memory ("
+			<< config.getMaxOverallMem() << " KB).\n";
+		delete process;
+		pidAllocator.release(pid);
+		processTable.release(name);
+		return false;
+	}
 
-		// Try to allocate memory for the process
-		try {
-			if (memoryManager.allocateMemory(process, memSize)) {
-				processes[name] = process;
-				scheduler->addProcess(process);
-				return true;
-			}
-			else {
-				// Not enough memory, cannot create process
-				delete process;
-				std::cout << "Not enough memory to create process '" << name
-					<< "' (required: " << memSize << " KB).\n";
-				return false;
-			}
+	process->setMemorySize(memSize);
+	if (program) {
+		process->loadProgram(std::move(program));
+	}
+
+	// Try to allocate memory for the process
+	try {
+		if (memoryManager.allocateMemory(process, memSize)) {
+			processTable.publish(process);
+			scheduler->addProcess(process);
+			return true;
 		}
-		catch (const std::exception& e) {
+		else {
+			// Not enough memory, cannot create process
 			delete process;
-			std::cout << "Error allocating memory for process '" << name
-				<< "': " << e.what() << "\n";
+			pidAllocator.release(pid);
+			processTable.release(name);
+			std::cout << "Not enough memory to create process '" << name
+				<< "' (required: " << memSize << " KB).\n";
 			return false;
 		}
 	}
-	else {
-		std::cout << "Process with name '" << name << "' already exists.\n";
+	catch (const std::exception& e) {
+		delete process;
+		pidAllocator.release(pid);
+		processTable.release(name);
+		std::cout << "Error allocating memory for process '" << name
+			<< "': " << e.what() << "\n";
 		return false;
 	}
 }
 
-Process* ConsoleManager::getProcess(const std::string& name) {
-	std::lock_guard<std::mutex> lock(processMutex);
-	auto it = processes.find(name);
-	if (it != processes.end()) {
-		return it->second;
+Process* ConsoleManager::forkProcess(Process* parent, const std::string& name) {
+	int pid = pidAllocator.allocate();
+	if (pid < 0) {
+		return nullptr;
 	}
-	else {
-		std::cout << "No process found with name '" << name << "'.\n";
+
+	std::string childName = name.empty() ? parent->getName() + "-" + std::to_string(pid) : name;
+	if (!processTable.reserve(childName)) {
+		pidAllocator.release(pid);
 		return nullptr;
 	}
+
+	Process* child = new Process(childName, pid);
+	memoryManager.cloneAddressSpace(parent, child);
+	processTable.publish(child);
+	scheduler->addProcess(child);
+	return child;
+}
+
+ConsoleManager::ProcessHold::ProcessHold(ConsoleManager& manager) : manager(manager) {
+	manager.processHolds++;
+}
+
+ConsoleManager::ProcessHold::~ProcessHold() {
+	manager.processHolds--;
+}
+
+Process* ConsoleManager::getProcess(const std::string& name) {
+	Process* process = processTable.findByName(name);
+	if (process == nullptr) {
+		std::cout << "No process found with name '" << name << "'.\n";
+	}
+	return process;
 }
 
-std::map<std::string, Process*>& ConsoleManager::getProcesses() {
-	return processes;
+Process* ConsoleManager::getProcessById(int id) {
+	return processTable.findById(id);
+}
+
+std::vector<Process*> ConsoleManager::getProcessSnapshot() const {
+	return processTable.snapshot();
+}
+
+void ConsoleManager::forEachProcess(const std::function<void(Process*)>& visitor) const {
+	processTable.forEach(visitor);
+}
+
+ProcessRanking& ConsoleManager::getProcessRanking() {
+	return processTable.getRanking();
+}
+
+size_t ConsoleManager::getNumProcesses() const {
+	return processTable.size();
+}
+
+const ProcessArchive& ConsoleManager::getProcessArchive() const {
+	return processArchive;
 }
 
 MemoryManager& ConsoleManager::getMemoryManager() {
@@ -313,20 +476,19 @@ void ConsoleManager::generateTestProcess(const std::string& baseName, std::strin
 	int processNum = processCounter++;
 	std::string processName = baseName + std::to_string(processNum);
 
-	if (createProcess(processName)) {
-		Process* process = getProcess(processName);
-		if (process) {
-			Config& config = Config::getInstance();
-			unsigned int numIns = config.getMinIns() + rand() % (config.getMaxIns() - config.getMinIns() + 1);
-
-			for (unsigned int j = 0; j < numIns; ++j) {
-				process->addCommand(new PrintCommand("Hello from " + processName + " Instruction " + std::to_string(j + 1)));
-			}
-
-			// Only output if we're in batch mode (-p flag)
-			if (outputStream) {
-				*outputStream << "Generated process: " << processName << " with " << numIns << " print commands.\n";
-			}
+	Config& config = Config::getInstance();
+	unsigned int numIns = config.getMinIns() + rand() % (config.getMaxIns() - config.getMinIns() + 1);
+	unsigned int memSize = randomMemorySize();
+
+	// Build the program before the process is published to the scheduler
+	auto program = std::make_shared<Program>();
+	InstructionGenerator::generate(*program, numIns, memSize);
+	program->optimize();
+
+	if (createProcess(processName, std::move(program), memSize)) {
+		// Only output if we're in batch mode (-p flag)
+		if (outputStream) {
+			*outputStream << "Generated process: " << processName << " with " << numIns << " instructions.\n";
 		}
 	}
 	else if (outputStream) {
@@ -334,16 +496,118 @@ void ConsoleManager::generateTestProcess(const std::string& baseName, std::strin
 	}
 }
 
+unsigned int ConsoleManager::randomMemorySize() const {
+	Config& config = Config::getInstance();
+	unsigned int minMem = config.getMinMemPerProc();
+	unsigned int maxMem = config.getMaxMemPerProc();
+	return minMem + rand() % (maxMem - minMem + 1);
+}
+
 void ConsoleManager::startSchedulerTestWithProcesses(int numProcesses) {
 	std::stringstream outputBuffer;
 	std::cout << "Generating " << numProcesses << " processes...\n";
 
-	for (int i = 0; i < numProcesses; ++i) {
-		generateTestProcess("process", &outputBuffer);
-	}
+	auto start = std::chrono::steady_clock::now();
+	size_t created = createProcesses(numProcesses, ProcessSpec::fromConfig("process"), &outputBuffer);
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
 
 	// Print all process generation messages at once
 	std::cout << outputBuffer.str();
+	std::cout << "Created " << created << " of " << numProcesses << " processes in " << elapsed.count() << " ms.\n";
+}
+
+ProcessSpec ProcessSpec::fromConfig(const std::string& baseName) {
+	Config& config = Config::getInstance();
+	ProcessSpec spec;
+	spec.baseName = baseName;
+	spec.minIns = config.getMinIns();
+	spec.maxIns = config.getMaxIns();
+	spec.minMem = config.getMinMemPerProc();
+	spec.maxMem = config.getMaxMemPerProc();
+	spec.numDistinctPrograms = 256;
+	return spec;
+}
+
+size_t ConsoleManager::createProcesses(size_t count, const ProcessSpec& spec, std::stringstream* outputStream) {
+	// Per-process messages are only worth printing for small batches
+	const size_t maxListed = 100;
+
+	int firstNum = processCounter.fetch_add(static_cast<int>(count));
+
+	std::vector<int> pids;
+	pids.reserve(count);
+	count = pidAllocator.allocateBatch(count, pids);
+
+	// Stage 1: generate the shared programs. Their READ/WRITE addresses stay
+	// below the smallest memory size, so any process can run any of them.
+	size_t numPrograms = std::max<size_t>(1, std::min<size_t>(count, spec.numDistinctPrograms));
+	std::vector<std::shared_ptr<Program>> programs(numPrograms);
+	creationPool.parallelFor(numPrograms, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			unsigned int numIns = InstructionGenerator::randomInRange(spec.minIns, spec.maxIns);
+			programs[i] = std::make_shared<Program>();
+			InstructionGenerator::generate(*programs[i], numIns, spec.minMem);
+			programs[i]->optimize();
+		}
+		});
+
+	// Stage 2: claim names and build the process objects in parallel
+	std::vector<Process*> processes(count, nullptr);
+	creationPool.parallelFor(count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			std::string name = spec.baseName + std::to_string(firstNum + i);
+			if (!processTable.reserve(name)) continue;
+
+			Process* process = new Process(name, pids[i]);
+			process->setMemorySize(InstructionGenerator::randomInRange(spec.minMem, spec.maxMem));
+			process->loadProgram(programs[i % numPrograms]);
+			processes[i] = process;
+		}
+		});
+
+	std::vector<Process*> built;
+	built.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (processes[i] != nullptr) {
+			built.push_back(processes[i]);
+		}
+		else {
+			pidAllocator.release(pids[i]);
+			if (outputStream && count <= maxListed) {
+				*outputStream << "Process with name '" << spec.baseName << firstNum + i << "' already exists. Skipping...\n";
+			}
+		}
+	}
+
+	// Stage 3: one memory manager call admits the whole batch
+	std::vector<Process*> rejected = memoryManager.allocateMemoryBatch(built);
+	if (!rejected.empty()) {
+		std::unordered_set<Process*> rejectedSet(rejected.begin(), rejected.end());
+		built.erase(std::remove_if(built.begin(), built.end(), [&rejectedSet](Process* process) {
+			return rejectedSet.count(process) > 0;
+			}), built.end());
+
+		for (Process* process : rejected) {
+			if (outputStream && count <= maxListed) {
+				*outputStream << "Failed to create process '" << process->getName() << "'. Skipping...\n";
+			}
+			processTable.release(process->getName());
+			pidAllocator.release(process->getId());
+			delete process;
+		}
+	}
+
+	// Stage 4: publish everything at once
+	processTable.publishBatch(built);
+	scheduler->addProcesses(built);
+
+	if (outputStream && count <= maxListed) {
+		for (Process* process : built) {
+			*outputStream << "Generated process: " << process->getName() << " with "
+				<< process->getTotalLines() << " instructions.\n";
+		}
+	}
+	return built.size();
 }
 
 void ConsoleManager::startSchedulerTestWithDuration(int seconds) {
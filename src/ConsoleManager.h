@@ -2,19 +2,43 @@
 
 #include "Config.h"
 #include "Console.h"
+#include "ConsoleOutput.h"
 #include "Process.h"
 #include "Scheduler.h"
 #include "MemoryManager.h"
+#include "Program.h"
+#include "ProcessTable.h"
+#include "ProcessArchive.h"
+#include "PidAllocator.h"
+#include "ThreadPool.h"
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 #include <condition_variable>
 #include <atomic>
 #include <sstream>
 
 class MainConsole;
 
+// Parameters for bulk process creation
+struct ProcessSpec {
+    std::string baseName;
+    unsigned int minIns;
+    unsigned int maxIns;
+    unsigned int minMem;
+    unsigned int maxMem;
+
+    // Processes share this many generated programs round-robin; a program
+    // is copied only if a process later modifies it
+    unsigned int numDistinctPrograms;
+
+    static ProcessSpec fromConfig(const std::string& baseName);
+};
+
 class ConsoleManager {
 public:
     ConsoleManager();
@@ -25,11 +49,46 @@ public:
 
     void start();
     void switchToMainConsole();
-    void switchToScreen(Process* process);
+    void switchToScreen(const std::string& name);
+
+    // memSize of 0 picks a random size within the configured bounds
+    bool createProcess(const std::string& name, std::shared_ptr<Program> program = nullptr, unsigned int memSize = 0);
+
+    // Builds count processes in parallel, admits them in one batched memory
+    // call and publishes them together. Returns how many were created.
+    size_t createProcesses(size_t count, const ProcessSpec& spec, std::stringstream* outputStream = nullptr);
+    // Clones a running process. The child shares the parent's program and
+    // its resident pages copy-on-write and resumes where the parent is.
+    // An empty name derives one from the parent's name and the new PID.
+    // Returns nullptr if the name is taken or no PID is free.
+    Process* forkProcess(Process* parent, const std::string& name = "");
+
+    // Parks a process that is sleeping off the core; the CPU cycle counter
+    // hands it back to the scheduler once ticks cycles have passed
+    void sleepProcess(Process* process, unsigned int ticks);
+
+    // Keeps retired processes from being freed while it lives. Take one
+    // before looking up, snapshotting or ranking processes, and keep it
+    // until done with the pointers they return.
+    class ProcessHold {
+    public:
+        explicit ProcessHold(ConsoleManager& manager);
+        ~ProcessHold();
+
+        ProcessHold(const ProcessHold&) = delete;
+        ProcessHold& operator=(const ProcessHold&) = delete;
+
+    private:
+        ConsoleManager& manager;
+    };
 
-    bool createProcess(const std::string& name);
     Process* getProcess(const std::string& name);
-    std::map<std::string, Process*>& getProcesses();
+    Process* getProcessById(int id);
+    std::vector<Process*> getProcessSnapshot() const;
+    void forEachProcess(const std::function<void(Process*)>& visitor) const;
+    ProcessRanking& getProcessRanking();
+    size_t getNumProcesses() const;
+    const ProcessArchive& getProcessArchive() const;
 
     MemoryManager& getMemoryManager();
     Scheduler* getScheduler();
@@ -56,8 +115,19 @@ public:
 
 private:
     MainConsole* mainConsole;
-    std::map<std::string, Process*> processes;
-    std::mutex processMutex;
+    PidAllocator pidAllocator;
+    ThreadPool creationPool;
+    ProcessTable processTable;
+
+    // Retention of finished processes. Retired processes are freed on a
+    // later pass that finds no ProcessHold alive, so whoever got a pointer
+    // before the process left the table is done with it.
+    static constexpr unsigned int kRetentionIntervalCycles = 1000;
+    void retireFinishedProcesses();
+    ProcessArchive processArchive;
+    std::vector<Process*> retiredProcesses;
+    std::mutex retentionMutex;
+    std::atomic<unsigned int> processHolds;
 
     // For CPU cycle functionality
     std::atomic<unsigned int> cpuCycles;
@@ -67,12 +137,18 @@ private:
     std::condition_variable cpuCycleCV;
     void cpuCycleLoop();
 
+    // Sleeping processes by the cycle they wake on
+    std::multimap<unsigned int, Process*> sleepingProcesses;
+    std::mutex sleepMutex;
+    void wakeSleepingProcesses();
+
     MemoryManager memoryManager;
     Scheduler* scheduler;
 
     // For scheduler test
     void schedulerTestLoop();
     void generateTestProcess(const std::string& baseName, std::stringstream* outputStream = nullptr);
+    unsigned int randomMemorySize() const;
     std::thread testThread;
     bool testing;
     std::mutex testMutex;
@@ -80,8 +156,8 @@ private:
     std::atomic<int> processCounter{ 1 };
 
     // Console output management
-    std::string currentPrompt;
     std::mutex ioMutex;
+    ConsoleOutput consoleOutput;
 
     bool initialized;
 };
\ No newline at end of file
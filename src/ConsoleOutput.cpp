@@ -0,0 +1,99 @@
+#include "ConsoleOutput.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// A producer that pushes just as the output thread decides to sleep can
+// miss waking it; the timed wait bounds how late that output appears
+const std::chrono::milliseconds kMaxSleep(20);
+
+} // namespace
+
+ConsoleOutput::ConsoleOutput(std::mutex& ioMutex)
+    : ioMutex(ioMutex), running(true), waiting(false) {
+    Node* stub = new Node();
+    head.store(stub);
+    tail = stub;
+    outputThread = std::thread(&ConsoleOutput::outputLoop, this);
+}
+
+ConsoleOutput::~ConsoleOutput() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running.store(false);
+    }
+    wakeCondition.notify_one();
+    outputThread.join();
+    delete tail;
+}
+
+void ConsoleOutput::print(const std::string& message) {
+    Node* node = new Node();
+    node->text = message;
+
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+
+    if (waiting.load()) {
+        wakeCondition.notify_one();
+    }
+}
+
+ConsoleOutput::Node* ConsoleOutput::pop() {
+    // A producer between its exchange and its link looks like an empty
+    // queue for a moment; its notify comes after the link
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+        return nullptr;
+    }
+    delete tail;
+    tail = next;
+    return next;
+}
+
+void ConsoleOutput::outputLoop() {
+    while (true) {
+        writeBatch();
+        if (!running.load()) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        waiting.store(true);
+        if (tail->next.load(std::memory_order_acquire) == nullptr && running.load()) {
+            wakeCondition.wait_for(lock, kMaxSleep);
+        }
+        waiting.store(false);
+    }
+    writeBatch();
+}
+
+void ConsoleOutput::printPrompt() {
+    std::lock_guard<std::mutex> lock(ioMutex);
+    std::cout << prompt;
+    std::cout.flush();
+}
+
+void ConsoleOutput::setPrompt(const std::string& prompt) {
+    std::lock_guard<std::mutex> lock(ioMutex);
+    this->prompt = prompt;
+}
+
+void ConsoleOutput::writeBatch() {
+    batch.clear();
+
+    // Each popped node stays in the queue as its new tail until the next pop
+    for (Node* node = pop(); node != nullptr; node = pop()) {
+        batch += node->text;
+        batch += '\n';
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(ioMutex);
+    batch += prompt;
+    std::cout.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+    std::cout.flush();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Console output from background threads. Producers push onto a lock-free
+// multi-producer queue and return at once; one output thread drains
+// everything queued, writes it as a single block, flushes once and redraws
+// the prompt once, so no producer ever waits on the terminal.
+class ConsoleOutput {
+public:
+    explicit ConsoleOutput(std::mutex& ioMutex);
+    ~ConsoleOutput();   // writes whatever is still queued
+
+    // A line from any thread, followed by the prompt
+    void print(const std::string& message);
+
+    // The console thread draws its own prompt synchronously, so it stays in
+    // order with that thread's direct output
+    void printPrompt();
+    void setPrompt(const std::string& prompt);
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        std::string text;
+    };
+
+    Node* pop();
+    void outputLoop();
+    void writeBatch();
+
+    // Producers link onto head with one exchange; only the output thread
+    // touches tail, which always points at an already consumed node
+    std::atomic<Node*> head;
+    Node* tail;
+
+    std::mutex& ioMutex;        // held while a batch or the prompt is written
+    std::string prompt;         // guarded by ioMutex
+    std::string batch;
+
+    std::atomic<bool> running;
+    std::atomic<bool> waiting;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::thread outputThread;
+};
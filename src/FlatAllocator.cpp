@@ -0,0 +1,258 @@
+#include "FlatAllocator.h"
+
+constexpr size_t BlockAllocator::kNoSpace;
+
+FlatAllocator::FlatAllocator(size_t capacity, FitPolicy policy)
+    : capacity(capacity), used(0), policy(policy), root(-1), seed(0x9E3779B9u) {
+    if (capacity > 0) {
+        addFree(0, capacity);
+    }
+}
+
+FitPolicy FlatAllocator::getPolicy() const {
+    return policy;
+}
+
+size_t FlatAllocator::allocate(Process* owner, size_t size) {
+    if (size == 0 || ownerIndex.count(owner) != 0) {
+        return kNoSpace;
+    }
+    size_t start = findFit(size);
+    if (start == kNoSpace) {
+        return kNoSpace;
+    }
+
+    size_t freeSize = freeByStart[start];
+    removeFree(start, freeSize);
+    if (freeSize > size) {
+        // Split; the remainder stays free at the high end
+        addFree(start + size, freeSize - size);
+    }
+
+    allocations[start] = { owner, size };
+    ownerIndex[owner] = start;
+    used += size;
+    return start;
+}
+
+bool FlatAllocator::release(Process* owner, size_t& offset, size_t& size) {
+    auto it = ownerIndex.find(owner);
+    if (it == ownerIndex.end()) {
+        return false;
+    }
+    offset = it->second;
+    size = allocations[offset].size;
+    ownerIndex.erase(it);
+    allocations.erase(offset);
+    used -= size;
+    freeRange(offset, size);
+    return true;
+}
+
+bool FlatAllocator::compactStep(Process*& owner, size_t& from, size_t& to, size_t& size) {
+    int node = root;
+    if (node < 0) {
+        return false;
+    }
+    while (nodes[node].left >= 0) {
+        node = nodes[node].left;
+    }
+    size_t holeStart = nodes[node].start;
+    size_t holeSize = nodes[node].size;
+
+    // Free blocks are coalesced, so the lowest one is followed by an
+    // allocation unless it already runs to the end of memory
+    auto it = allocations.find(holeStart + holeSize);
+    if (it == allocations.end()) {
+        return false;
+    }
+    owner = it->second.owner;
+    from = it->first;
+    to = holeStart;
+    size = it->second.size;
+
+    allocations.erase(it);
+    allocations[to] = { owner, size };
+    ownerIndex[owner] = to;
+    removeFree(holeStart, holeSize);
+    freeRange(to + size, holeSize);
+    return true;
+}
+
+void FlatAllocator::freeRange(size_t start, size_t length) {
+    // Boundary tags: a free block ending where this one starts, and one
+    // starting where it ends
+    auto before = freeByEnd.find(start);
+    if (before != freeByEnd.end()) {
+        size_t previousStart = before->second;
+        size_t previousSize = start - previousStart;
+        removeFree(previousStart, previousSize);
+        start = previousStart;
+        length += previousSize;
+    }
+    auto after = freeByStart.find(start + length);
+    if (after != freeByStart.end()) {
+        size_t nextSize = after->second;
+        removeFree(start + length, nextSize);
+        length += nextSize;
+    }
+    addFree(start, length);
+}
+
+bool FlatAllocator::find(const Process* owner, size_t& offset, size_t& size) const {
+    auto it = ownerIndex.find(owner);
+    if (it == ownerIndex.end()) {
+        return false;
+    }
+    offset = it->second;
+    size = allocations.at(offset).size;
+    return true;
+}
+
+size_t FlatAllocator::getUsed() const {
+    return used;
+}
+
+size_t FlatAllocator::getRequested() const {
+    return used;
+}
+
+size_t FlatAllocator::getNumFreeBlocks() const {
+    return freeBySize.size();
+}
+
+size_t FlatAllocator::getLargestFreeBlock() const {
+    return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+const char* FlatAllocator::getName() const {
+    switch (policy) {
+    case FitPolicy::Best: return "best fit";
+    case FitPolicy::Worst: return "worst fit";
+    default: return "first fit";
+    }
+}
+
+void FlatAllocator::forEachAllocation(const std::function<void(Process*, size_t, size_t)>& visitor) const {
+    for (const auto& pair : allocations) {
+        visitor(pair.second.owner, pair.first, pair.second.size);
+    }
+}
+
+void FlatAllocator::addFree(size_t start, size_t size) {
+    freeByStart[start] = size;
+    freeByEnd[start + size] = start;
+    freeBySize.emplace(size, start);
+    treeInsert(start, size);
+}
+
+void FlatAllocator::removeFree(size_t start, size_t size) {
+    freeByStart.erase(start);
+    freeByEnd.erase(start + size);
+    freeBySize.erase(std::make_pair(size, start));
+    treeErase(start);
+}
+
+size_t FlatAllocator::findFit(size_t size) const {
+    switch (policy) {
+    case FitPolicy::Best: {
+        auto it = freeBySize.lower_bound(std::make_pair(size, size_t(0)));
+        return it != freeBySize.end() ? it->second : kNoSpace;
+    }
+    case FitPolicy::Worst:
+        if (freeBySize.empty() || freeBySize.rbegin()->first < size) {
+            return kNoSpace;
+        }
+        return freeBySize.rbegin()->second;
+    default:
+        return treeFirstFit(size);
+    }
+}
+
+int FlatAllocator::newNode(size_t start, size_t size) {
+    // xorshift; priorities only need to look random to keep the treap balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    Node node = { start, size, size, seed, -1, -1 };
+    if (!freeNodes.empty()) {
+        int index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = node;
+        return index;
+    }
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void FlatAllocator::update(int node) {
+    Node& n = nodes[node];
+    n.maxSize = n.size;
+    if (n.left >= 0 && nodes[n.left].maxSize > n.maxSize) n.maxSize = nodes[n.left].maxSize;
+    if (n.right >= 0 && nodes[n.right].maxSize > n.maxSize) n.maxSize = nodes[n.right].maxSize;
+}
+
+void FlatAllocator::split(int node, size_t start, int& left, int& right) {
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    if (nodes[node].start < start) {
+        split(nodes[node].right, start, nodes[node].right, right);
+        left = node;
+    }
+    else {
+        split(nodes[node].left, start, left, nodes[node].left);
+        right = node;
+    }
+    update(node);
+}
+
+int FlatAllocator::merge(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
+}
+
+void FlatAllocator::treeInsert(size_t start, size_t size) {
+    int left, right;
+    split(root, start, left, right);
+    root = merge(merge(left, newNode(start, size)), right);
+}
+
+void FlatAllocator::treeErase(size_t start) {
+    int left, middle, right;
+    split(root, start, left, right);
+    split(right, start + 1, middle, right);
+    if (middle >= 0) {
+        freeNodes.push_back(middle);    // free blocks never share a start
+    }
+    root = merge(left, right);
+}
+
+size_t FlatAllocator::treeFirstFit(size_t size) const {
+    int node = root;
+    if (node < 0 || nodes[node].maxSize < size) {
+        return kNoSpace;
+    }
+    while (true) {
+        const Node& n = nodes[node];
+        if (n.left >= 0 && nodes[n.left].maxSize >= size) {
+            node = n.left;
+        }
+        else if (n.size >= size) {
+            return n.start;
+        }
+        else {
+            node = n.right;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "BlockAllocator.h"
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class FitPolicy {
+    First,      // lowest-addressed free block that fits
+    Best,       // smallest free block that fits
+    Worst       // largest free block
+};
+
+// Contiguous allocation for the flat memory model, one block per process.
+// Free blocks are indexed three ways: by start and by end in hash maps, so
+// a freed block finds both neighbours to coalesce with in O(1); by (size,
+// start) in an ordered set for best and worst fit; and in a treap ordered
+// by start whose nodes carry the largest free size in their subtree, so
+// first fit descends straight to the lowest block that fits. Allocated
+// blocks are indexed by owner and by start. Every operation is O(log n) in
+// the number of blocks.
+class FlatAllocator : public BlockAllocator {
+public:
+    FlatAllocator(size_t capacity, FitPolicy policy);
+
+    FitPolicy getPolicy() const;
+
+    size_t allocate(Process* owner, size_t size) override;
+
+    // Merges the freed block with its free neighbours
+    bool release(Process* owner, size_t& offset, size_t& size) override;
+    bool find(const Process* owner, size_t& offset, size_t& size) const override;
+
+    size_t getUsed() const override;
+    size_t getRequested() const override;      // blocks are never rounded up
+    size_t getNumFreeBlocks() const override;
+    size_t getLargestFreeBlock() const override;
+    const char* getName() const override;
+    bool compactStep(Process*& owner, size_t& from, size_t& to, size_t& size) override;
+
+    void forEachAllocation(const std::function<void(Process*, size_t, size_t)>& visitor) const override;
+
+private:
+    struct Allocation {
+        Process* owner;
+        size_t size;
+    };
+
+    void addFree(size_t start, size_t size);
+    void removeFree(size_t start, size_t size);
+    void freeRange(size_t start, size_t size);     // adds a free block merged with its neighbours
+    size_t findFit(size_t size) const;
+
+    // Treap of free blocks keyed by start, in a node pool
+    struct Node {
+        size_t start;
+        size_t size;
+        size_t maxSize;     // largest size in this subtree
+        uint32_t priority;
+        int left;
+        int right;
+    };
+
+    int newNode(size_t start, size_t size);
+    void update(int node);
+    void split(int node, size_t start, int& left, int& right);    // left: keys < start
+    int merge(int left, int right);
+    void treeInsert(size_t start, size_t size);
+    void treeErase(size_t start);
+    size_t treeFirstFit(size_t size) const;
+
+    size_t capacity;
+    size_t used;
+    FitPolicy policy;
+
+    std::unordered_map<size_t, size_t> freeByStart;    // start -> size
+    std::unordered_map<size_t, size_t> freeByEnd;      // end -> start
+    std::set<std::pair<size_t, size_t>> freeBySize;    // (size, start)
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root;
+    uint32_t seed;
+
+    std::unordered_map<const Process*, size_t> ownerIndex;     // owner -> start
+    std::map<size_t, Allocation> allocations;                  // start -> block
+};
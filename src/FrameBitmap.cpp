@@ -0,0 +1,113 @@
+#include "FrameBitmap.h"
+#include "BitOps.h"
+#include <algorithm>
+
+constexpr size_t FrameBitmap::kInitialCoverage;
+
+FrameBitmap::FrameBitmap()
+    : numFrames(0), coverage(0), numUsed(0) {}
+
+void FrameBitmap::reset(size_t numFrames) {
+    this->numFrames = numFrames;
+    numUsed = 0;
+    coverage = 0;
+    levels.assign(1, std::vector<uint64_t>());
+    cover(std::min(numFrames, kInitialCoverage));
+}
+
+void FrameBitmap::cover(size_t frames) {
+    // New frames are free; the old last word had its bits past the end cleared
+    std::vector<uint64_t>& leaves = levels[0];
+    size_t oldCoverage = coverage;
+    leaves.resize((frames + 63) / 64, ~uint64_t(0));
+    if (oldCoverage % 64 != 0) {
+        leaves[oldCoverage / 64] |= BitOps::maskFrom(oldCoverage % 64);
+    }
+    if (frames % 64 != 0) {
+        leaves.back() &= ~BitOps::maskFrom(frames % 64);
+    }
+    if (leaves.empty()) {
+        leaves.push_back(0);
+    }
+    coverage = frames;
+
+    // Rebuild the summaries over the grown leaf level
+    levels.resize(1);
+    while (levels.back().size() > 1) {
+        const std::vector<uint64_t>& below = levels.back();
+        std::vector<uint64_t> summary((below.size() + 63) / 64, 0);
+        for (size_t i = 0; i < below.size(); ++i) {
+            if (below[i] != 0) {
+                summary[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+        levels.push_back(std::move(summary));
+    }
+}
+
+int FrameBitmap::allocate() {
+    if (numUsed == numFrames) {
+        return -1;
+    }
+    if (numUsed == coverage) {
+        cover(std::min(numFrames, coverage * 2));
+    }
+    // Every set summary bit has a free frame below it, so the descent
+    // never backtracks
+    size_t index = 0;
+    for (size_t level = levels.size(); level-- > 0; ) {
+        index = index * 64 + BitOps::countTrailingZeros(levels[level][index]);
+    }
+    markUsed(static_cast<int>(index));
+    return static_cast<int>(index);
+}
+
+void FrameBitmap::markUsed(int frame) {
+    size_t index = static_cast<size_t>(frame);
+    if (index >= coverage) {
+        cover(std::min(numFrames, std::max(coverage * 2, index + 1)));
+    }
+    uint64_t bit = uint64_t(1) << (index % 64);
+    if ((levels[0][index / 64] & bit) == 0) {
+        return;
+    }
+    numUsed++;
+
+    // Clear upwards for as long as a word becomes full
+    for (auto& words : levels) {
+        uint64_t& word = words[index / 64];
+        word &= ~(uint64_t(1) << (index % 64));
+        if (word != 0) break;
+        index /= 64;
+    }
+}
+
+void FrameBitmap::markFree(int frame) {
+    size_t index = static_cast<size_t>(frame);
+    if (index >= coverage || ((levels[0][index / 64] >> (index % 64)) & 1)) {
+        return;
+    }
+    numUsed--;
+
+    // Set upwards for as long as a word was full before
+    for (auto& words : levels) {
+        uint64_t& word = words[index / 64];
+        bool wasFull = (word == 0);
+        word |= uint64_t(1) << (index % 64);
+        if (!wasFull) break;
+        index /= 64;
+    }
+}
+
+bool FrameBitmap::isFree(int frame) const {
+    size_t index = static_cast<size_t>(frame);
+    return index >= coverage || ((levels[0][index / 64] >> (index % 64)) & 1);
+}
+
+size_t FrameBitmap::getNumUsed() const {
+    return numUsed;
+}
+
+size_t FrameBitmap::getNumFrames() const {
+    return numFrames;
+}
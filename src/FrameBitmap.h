@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Free-frame map for paging. Level 0 holds one bit per frame; each level
+// above holds one bit per word of the level below, set while that word
+// still has a free frame, up to a single top word. Finding the lowest
+// free frame is one count-trailing-zeros per level, so a few word reads
+// even for millions of frames, and the number in use is kept exactly.
+// Frames are handed out lowest first, so the map only covers frames up to
+// the highest one used so far and doubles when that fills; everything
+// above is free by definition.
+class FrameBitmap {
+public:
+    FrameBitmap();
+
+    void reset(size_t numFrames);      // every frame free
+
+    // Marks the lowest free frame in use and returns it, or -1 if none is free
+    int allocate();
+    void markUsed(int frame);
+    void markFree(int frame);
+    bool isFree(int frame) const;
+
+    size_t getNumUsed() const;
+    size_t getNumFrames() const;
+
+private:
+    static constexpr size_t kInitialCoverage = 4096;
+
+    void cover(size_t frames);      // extends the map to the first frames frames
+
+    // levels[0] is the frame bitmap; a set bit means free
+    std::vector<std::vector<uint64_t>> levels;
+    size_t numFrames;
+    size_t coverage;                // frames the map describes
+    size_t numUsed;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+struct ExecutionContext;
+struct Instruction;
+
+enum class OpCode : uint8_t {
+    Print,
+    Declare,
+    Add,
+    Subtract,
+    Read,
+    Write,
+    Sleep,
+    ForBegin,
+    ForEnd,
+    Fork
+};
+
+// Operands are decoded once when the program is built: either a variable
+// slot in the process's symbol table or a 16-bit literal. Variables live in
+// the symbol table at the start of the process's emulated address space.
+struct Operand {
+    uint16_t value = 0;
+    bool isVariable = false;
+};
+
+// Every instruction carries its own handler, so the interpreter jumps
+// straight to it without decoding the opcode. A handler returns the number
+// of instruction lines it retired; loop markers only move the pc.
+using InstructionHandler = uint32_t (*)(const Instruction& ins, ExecutionContext& ctx);
+
+struct Instruction {
+    InstructionHandler handler = nullptr;
+    OpCode op = OpCode::Print;
+    uint16_t target = 0;    // destination variable slot
+    Operand lhs;
+    Operand rhs;
+    uint32_t arg = 0;       // message id, address, sleep ticks or repeat count
+    uint32_t jump = 0;      // matching loop marker for ForBegin/ForEnd
+    uint32_t lines = 0;     // lines retired by handler (2 for fused pairs, a whole loop when cached)
+};
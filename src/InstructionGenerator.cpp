@@ -0,0 +1,102 @@
+#include "InstructionGenerator.h"
+#include "Process.h"
+#include <algorithm>
+#include <random>
+
+constexpr int InstructionGenerator::kMaxForDepth;
+
+namespace {
+
+const std::string variableNames[] = {
+    "x", "y", "z", "count", "total", "delta", "flag", "tmp"
+};
+const unsigned int numVariableNames = sizeof(variableNames) / sizeof(variableNames[0]);
+
+} // namespace
+
+void InstructionGenerator::generate(Program& program, unsigned int numIns, unsigned int memorySize) {
+    Spec spec = { memorySize };
+    generateBlock(program, numIns, 0, spec);
+}
+
+void InstructionGenerator::generateBlock(Program& program, unsigned int budget, int depth, const Spec& spec) {
+    while (budget > 0) {
+        // Roughly one in ten instructions opens a loop when there is room for one
+        if (depth < kMaxForDepth && budget >= 2 && randomBelow(10) == 0) {
+            unsigned int repeats = 2 + randomBelow(4);
+            repeats = std::min(repeats, budget);
+            unsigned int bodyBudget = std::min(1 + randomBelow(5), budget / repeats);
+
+            program.beginFor(repeats);
+            generateBlock(program, bodyBudget, depth + 1, spec);
+            program.endFor();
+
+            budget -= bodyBudget * repeats;
+        }
+        else {
+            generateSimple(program, spec);
+            budget--;
+        }
+    }
+}
+
+void InstructionGenerator::generateSimple(Program& program, const Spec& spec) {
+    unsigned int roll = randomBelow(100);
+    bool hasHeap = spec.memorySize >= Program::kSymbolTableSize + 2;
+
+    if (roll < 30) {
+        if (roll < 20) {
+            program.appendPrint(std::string("Hello world from ") + Process::kNamePlaceholder + "!");
+        }
+        else {
+            const std::string& name = randomVariable();
+            program.appendPrint("Value from " + name + ": ", program.variable(name));
+        }
+    }
+    else if (roll < 45) {
+        program.appendDeclare(randomVariable(), static_cast<uint16_t>(randomBelow(0x10000)));
+    }
+    else if (roll < 62) {
+        program.appendAdd(randomVariable(), randomOperand(program), randomOperand(program));
+    }
+    else if (roll < 79) {
+        program.appendSubtract(randomVariable(), randomOperand(program), randomOperand(program));
+    }
+    else if (roll < 86 && hasHeap) {
+        program.appendRead(randomVariable(), randomHeapAddress(spec));
+    }
+    else if (roll < 94 && hasHeap) {
+        program.appendWrite(randomHeapAddress(spec), randomOperand(program));
+    }
+    else if (roll < 94) {
+        program.appendAdd(randomVariable(), randomOperand(program), randomOperand(program));
+    }
+    else {
+        program.appendSleep(1 + randomBelow(255));
+    }
+}
+
+uint32_t InstructionGenerator::randomHeapAddress(const Spec& spec) {
+    uint32_t heapWords = (spec.memorySize - Program::kSymbolTableSize) / 2;
+    return Program::kSymbolTableSize + randomBelow(heapWords) * 2;
+}
+
+Operand InstructionGenerator::randomOperand(Program& program) {
+    if (randomBelow(2) == 0) {
+        return program.variable(randomVariable());
+    }
+    return Program::literal(static_cast<uint16_t>(randomBelow(0x10000)));
+}
+
+const std::string& InstructionGenerator::randomVariable() {
+    return variableNames[randomBelow(numVariableNames)];
+}
+
+unsigned int InstructionGenerator::randomInRange(unsigned int low, unsigned int high) {
+    return low + randomBelow(high - low + 1);
+}
+
+unsigned int InstructionGenerator::randomBelow(unsigned int bound) {
+    static thread_local std::mt19937 engine(std::random_device{}());
+    return std::uniform_int_distribution<unsigned int>(0, bound - 1)(engine);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Program.h"
+#include <string>
+
+// Builds random instruction mixes for scheduler-test processes
+class InstructionGenerator {
+public:
+    static constexpr int kMaxForDepth = 3;
+
+    // Appends instructions whose dynamic length (loop repetitions
+    // included) is exactly numIns. READ/WRITE addresses stay inside the
+    // heap of a memorySize-byte address space, and PRINT text names the
+    // process with a placeholder, so the program can be shared by any
+    // process at least that large.
+    static void generate(Program& program, unsigned int numIns, unsigned int memorySize);
+
+    // Uniform in [low, high] from a per-thread engine; safe to call from
+    // any thread, unlike rand()
+    static unsigned int randomInRange(unsigned int low, unsigned int high);
+
+private:
+    struct Spec {
+        unsigned int memorySize;
+    };
+
+    static void generateBlock(Program& program, unsigned int budget, int depth, const Spec& spec);
+    static void generateSimple(Program& program, const Spec& spec);
+    static uint32_t randomHeapAddress(const Spec& spec);
+    static Operand randomOperand(Program& program);
+    static const std::string& randomVariable();
+    static unsigned int randomBelow(unsigned int bound);
+};
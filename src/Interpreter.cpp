@@ -0,0 +1,378 @@
+#include "Interpreter.h"
+#include "Process.h"
+#include "Tlb.h"
+#include <cstring>
+#include <string>
+
+namespace {
+
+inline uint16_t load16(const uint8_t* p) {
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline void store16(uint8_t* p, uint16_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+// Translates a virtual address to a host pointer through the page map.
+// Records a fault and returns nullptr if the word is out of range, its
+// page is not resident, or it is a write to a copy-on-write page.
+inline uint8_t* translate(ExecutionContext& ctx, uint32_t address, bool write) {
+    if (uint64_t(address) + 2 > ctx.addressLimit) {
+        ctx.fault = MemoryFault::AccessViolation;
+        ctx.faultAddress = address;
+        return nullptr;
+    }
+    uint32_t page = address >> ctx.pageShift;
+    PageSlot* slot;
+    if (ctx.tlb != nullptr) {
+        slot = ctx.tlb->lookup(ctx.asid, page);
+        if (slot == nullptr) {
+            // Miss: walk the page table and cache the slot if it is mapped
+            slot = ctx.pageTable->find(page);
+            if (slot != nullptr && slot->base != nullptr) {
+                ctx.tlb->fill(ctx.asid, page, slot);
+            }
+        }
+    }
+    else {
+        slot = ctx.pageTable->find(page);
+    }
+    if (slot == nullptr || slot->base == nullptr) {
+        ctx.fault = MemoryFault::PageFault;
+        ctx.faultAddress = address;
+        return nullptr;
+    }
+    uint8_t& flags = slot->flags;
+    if (write) {
+        if (flags & PageFlags::ReadOnly) {
+            ctx.fault = MemoryFault::PageFault;
+            ctx.faultAddress = address;
+            return nullptr;
+        }
+        flags |= PageFlags::Dirty;
+    }
+    if (!(flags & PageFlags::Referenced)) {
+        flags |= PageFlags::Referenced;
+        if (ctx.numTouchedPages < ExecutionContext::kMaxTouchedPages) {
+            ctx.touchedPages[ctx.numTouchedPages++] = page;
+        }
+        else {
+            ctx.touchedOverflow = true;
+        }
+    }
+    ctx.residentAccesses++;
+    return slot->base + (address & ctx.pageMask);
+}
+
+inline bool isSymbolResident(const ExecutionContext& ctx, uint16_t slot) {
+    return uint32_t(slot) * 2 + 2 <= ctx.symbolLimit;
+}
+
+// Variables past the symbol table are ignored: they read as 0 and writes
+// land in a scratch word
+inline uint8_t* variableForWrite(ExecutionContext& ctx, uint16_t slot) {
+    if (!isSymbolResident(ctx, slot)) {
+        return reinterpret_cast<uint8_t*>(&ctx.scratch);
+    }
+    return translate(ctx, uint32_t(slot) * 2, true);
+}
+
+inline bool loadOperand(const Operand& operand, ExecutionContext& ctx, uint16_t& value) {
+    if (!operand.isVariable) {
+        value = operand.value;
+        return true;
+    }
+    if (!isSymbolResident(ctx, operand.value)) {
+        value = 0;
+        return true;
+    }
+    const uint8_t* p = translate(ctx, uint32_t(operand.value) * 2, false);
+    if (p == nullptr) {
+        return false;
+    }
+    value = load16(p);
+    return true;
+}
+
+// Variables are unsigned 16-bit and saturate instead of wrapping
+inline uint16_t clampToUint16(int32_t value) {
+    if (value < 0) return 0;
+    if (value > 0xFFFF) return 0xFFFF;
+    return static_cast<uint16_t>(value);
+}
+
+uint32_t execPrint(const Instruction& ins, ExecutionContext& ctx) {
+    if (ins.lhs.isVariable) {
+        uint16_t value;
+        if (!loadOperand(ins.lhs, ctx, value)) return 0;
+        if (ctx.process != nullptr && Process::isLoggingEnabled()) {
+            ctx.process->log(ctx.program->getMessage(ins.arg), value, ctx.coreId);
+        }
+    }
+    else if (ctx.process != nullptr && Process::isLoggingEnabled()) {
+        ctx.process->log(ctx.program->getMessage(ins.arg), ctx.coreId);
+    }
+    ++ctx.pc;
+    return 1;
+}
+
+// PRINT of a constant message: no operand to fetch or format
+uint32_t execPrintConstant(const Instruction& ins, ExecutionContext& ctx) {
+    if (ctx.process != nullptr && Process::isLoggingEnabled()) {
+        ctx.process->log(ctx.program->getMessage(ins.arg), ctx.coreId);
+    }
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execDeclare(const Instruction& ins, ExecutionContext& ctx) {
+    uint8_t* target = variableForWrite(ctx, ins.target);
+    if (target == nullptr) return 0;
+    store16(target, ins.lhs.value);
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execAdd(const Instruction& ins, ExecutionContext& ctx) {
+    uint16_t lhs, rhs;
+    if (!loadOperand(ins.lhs, ctx, lhs) || !loadOperand(ins.rhs, ctx, rhs)) return 0;
+    uint8_t* target = variableForWrite(ctx, ins.target);
+    if (target == nullptr) return 0;
+    store16(target, clampToUint16(int32_t(lhs) + int32_t(rhs)));
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execSubtract(const Instruction& ins, ExecutionContext& ctx) {
+    uint16_t lhs, rhs;
+    if (!loadOperand(ins.lhs, ctx, lhs) || !loadOperand(ins.rhs, ctx, rhs)) return 0;
+    uint8_t* target = variableForWrite(ctx, ins.target);
+    if (target == nullptr) return 0;
+    store16(target, clampToUint16(int32_t(lhs) - int32_t(rhs)));
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execRead(const Instruction& ins, ExecutionContext& ctx) {
+    const uint8_t* source = translate(ctx, ins.arg, false);
+    if (source == nullptr) return 0;
+    uint16_t value = load16(source);
+    uint8_t* target = variableForWrite(ctx, ins.target);
+    if (target == nullptr) return 0;
+    store16(target, value);
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execWrite(const Instruction& ins, ExecutionContext& ctx) {
+    uint16_t value;
+    if (!loadOperand(ins.lhs, ctx, value)) return 0;
+    uint8_t* target = translate(ctx, ins.arg, true);
+    if (target == nullptr) return 0;
+    store16(target, value);
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execSleep(const Instruction& ins, ExecutionContext& ctx) {
+    ctx.sleepTicks = ins.arg;
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execFork(const Instruction&, ExecutionContext& ctx) {
+    ctx.forkPending = true;
+    ++ctx.pc;
+    return 1;
+}
+
+uint32_t execForBegin(const Instruction& ins, ExecutionContext& ctx) {
+    if (ins.arg == 0) {
+        ctx.pc = ins.jump + 1;
+    }
+    else {
+        ctx.loopRemaining[ctx.loopDepth++] = ins.arg;
+        ++ctx.pc;
+    }
+    return 0;
+}
+
+uint32_t execForEnd(const Instruction& ins, ExecutionContext& ctx) {
+    if (--ctx.loopRemaining[ctx.loopDepth - 1] > 0) {
+        // Jump back to the first body instruction
+        ctx.pc = ins.jump + 1;
+    }
+    else {
+        --ctx.loopDepth;
+        ++ctx.pc;
+    }
+    return 0;
+}
+
+// Replays a straight-line loop body without pushing a loop frame or
+// dispatching the ForEnd marker on every iteration
+uint32_t execForCached(const Instruction& ins, ExecutionContext& ctx) {
+    const Instruction* code = ctx.program->data();
+    const uint32_t bodyStart = ctx.pc + 1;
+    const uint32_t bodyEnd = ins.jump;
+    uint32_t retired = 0;
+
+    for (uint32_t i = 0; i < ins.arg; ++i) {
+        ctx.pc = bodyStart;
+        while (ctx.pc < bodyEnd) {
+            const Instruction& body = code[ctx.pc];
+            retired += body.handler(body, ctx);
+            if (ctx.fault != MemoryFault::None) {
+                // Fall back to an ordinary loop frame so the faulting
+                // instruction resumes in the right iteration
+                ctx.loopRemaining[ctx.loopDepth++] = ins.arg - i;
+                return retired;
+            }
+        }
+    }
+    ctx.pc = bodyEnd + 1;
+    return retired;
+}
+
+// Superinstruction: two adjacent straight-line instructions in one dispatch
+template <InstructionHandler First, InstructionHandler Second>
+uint32_t execFused(const Instruction& ins, ExecutionContext& ctx) {
+    uint32_t retired = First(ins, ctx);
+    if (ctx.fault != MemoryFault::None) return retired;
+    return retired + Second((&ins)[1], ctx);
+}
+
+const InstructionHandler baseHandlers[] = {
+    &execPrint,
+    &execDeclare,
+    &execAdd,
+    &execSubtract,
+    &execRead,
+    &execWrite,
+    &execSleep,
+    &execForBegin,
+    &execForEnd,
+    &execFork
+};
+
+#define FUSED_ROW(first) \
+    { &execFused<first, execPrint>, &execFused<first, execDeclare>, \
+      &execFused<first, execAdd>,   &execFused<first, execSubtract>, \
+      &execFused<first, execRead>,  &execFused<first, execWrite> }
+
+// Indexed by [first][second] over the straight-line opcodes Print..Write
+const InstructionHandler fusedHandlers[6][6] = {
+    FUSED_ROW(execPrint),
+    FUSED_ROW(execDeclare),
+    FUSED_ROW(execAdd),
+    FUSED_ROW(execSubtract),
+    FUSED_ROW(execRead),
+    FUSED_ROW(execWrite)
+};
+
+#undef FUSED_ROW
+
+inline InstructionHandler baseHandler(OpCode op) {
+    return baseHandlers[static_cast<int>(op)];
+}
+
+} // namespace
+
+InstructionHandler Interpreter::handlerFor(OpCode op) {
+    return baseHandler(op);
+}
+
+InstructionHandler Interpreter::specializedHandlerFor(const Instruction& ins) {
+    if (ins.op == OpCode::Print && !ins.lhs.isVariable) {
+        return &execPrintConstant;
+    }
+    return baseHandler(ins.op);
+}
+
+InstructionHandler Interpreter::fusedHandlerFor(OpCode first, OpCode second) {
+    if (!isStraightLine(first) || !isStraightLine(second)) {
+        return nullptr;
+    }
+    return fusedHandlers[static_cast<int>(first)][static_cast<int>(second)];
+}
+
+InstructionHandler Interpreter::cachedLoopHandler() {
+    return &execForCached;
+}
+
+bool Interpreter::isStraightLine(OpCode op) {
+    return op == OpCode::Print || op == OpCode::Declare || op == OpCode::Add || op == OpCode::Subtract
+        || op == OpCode::Read || op == OpCode::Write;
+}
+
+bool Interpreter::isCountedLine(OpCode op) {
+    return isStraightLine(op) || op == OpCode::Sleep || op == OpCode::Fork;
+}
+
+Interpreter::StepResult Interpreter::step(ExecutionContext& ctx) {
+    if (ctx.sleepTicks > 0) {
+        --ctx.sleepTicks;
+        return StepResult::Sleeping;
+    }
+
+    const Instruction* code = ctx.program->data();
+    const uint32_t size = ctx.program->size();
+    ctx.fault = MemoryFault::None;
+
+    // Single-stepping always uses the unfused handlers so exactly one line
+    // retires per call. Loop markers do not count as lines, so keep
+    // dispatching until one instruction retires.
+    while (ctx.pc < size) {
+        const uint32_t pc = ctx.pc;
+        const Instruction& ins = code[pc];
+        uint32_t retired = baseHandler(ins.op)(ins, ctx);
+        if (ctx.fault != MemoryFault::None) {
+            return ctx.fault == MemoryFault::PageFault ? StepResult::PageFault : StepResult::AccessViolation;
+        }
+        if (retired > 0) {
+            ctx.lastPc = pc;
+            if (ctx.forkPending) {
+                ctx.forkPending = false;
+                return StepResult::Forked;
+            }
+            return StepResult::Executed;
+        }
+    }
+    return StepResult::Finished;
+}
+
+uint64_t Interpreter::run(ExecutionContext& ctx, uint64_t maxLines) {
+    const Instruction* code = ctx.program->data();
+    const uint32_t size = ctx.program->size();
+    uint64_t retired = 0;
+    ctx.fault = MemoryFault::None;
+
+    while (ctx.pc < size && retired < maxLines && ctx.fault == MemoryFault::None && !ctx.forkPending) {
+        const Instruction& ins = code[ctx.pc];
+        if (ins.lines <= maxLines - retired) {
+            retired += ins.handler(ins, ctx);
+        }
+        else {
+            // Not enough budget left for the whole superinstruction
+            retired += baseHandler(ins.op)(ins, ctx);
+        }
+    }
+    ctx.sleepTicks = 0;
+    return retired;
+}
+
+void Interpreter::attachMemory(ExecutionContext& ctx, SparseTable<PageSlot>* pageTable,
+    uint32_t pageShift, uint32_t addressLimit) {
+    ctx.pageTable = pageTable;
+    ctx.pageShift = pageShift;
+    ctx.pageMask = (1u << pageShift) - 1;
+    ctx.addressLimit = addressLimit;
+    ctx.symbolLimit = addressLimit < Program::kSymbolTableSize ? (addressLimit & ~1u) : Program::kSymbolTableSize;
+}
+
+bool Interpreter::hasRemainingWork(const ExecutionContext& ctx) {
+    return ctx.sleepTicks > 0 || (ctx.program != nullptr && ctx.pc < ctx.program->size());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Instruction.h"
+#include "Program.h"
+#include "SparseTable.h"
+#include <cstdint>
+
+class Process;
+class Tlb;
+
+// Per-page flag bits kept next to the page map
+namespace PageFlags {
+    constexpr uint8_t Dirty = 0x1;      // written while resident
+    constexpr uint8_t ReadOnly = 0x2;   // shared copy-on-write; a write faults
+    constexpr uint8_t Referenced = 0x4; // accessed since the memory manager last looked
+}
+
+// One page of a process's address space
+struct PageSlot {
+    uint8_t* base = nullptr;    // host address, nullptr while not resident
+    uint8_t flags = 0;          // PageFlags bits
+};
+
+enum class MemoryFault : uint8_t {
+    None,
+    PageFault,
+    AccessViolation
+};
+
+// Per-process execution state for a Program
+struct ExecutionContext {
+    const Program* program = nullptr;
+    Process* process = nullptr;
+    int coreId = -1;
+
+    uint32_t pc = 0;
+    uint32_t lastPc = 0;
+    uint32_t sleepTicks = 0;
+
+    int loopDepth = 0;
+    uint32_t loopRemaining[Program::kMaxLoopDepth] = {};
+
+    // Emulated address space, one slot per virtual page. Slots of pages
+    // that were never resident may not exist.
+    SparseTable<PageSlot>* pageTable = nullptr;
+    uint32_t pageShift = 0;
+    uint32_t pageMask = 0;
+    uint32_t addressLimit = 0;
+    uint32_t symbolLimit = 0;
+
+    // Translation cache of the core running the process, set per step,
+    // and the address-space tag its entries carry
+    Tlb* tlb = nullptr;
+    uint32_t asid = 0;
+
+    // Pages referenced for the first time since the owner last collected
+    // them, for page replacement, and the accesses that found their page
+    // resident. A full log sets touchedOverflow instead.
+    static constexpr uint32_t kMaxTouchedPages = 8;
+    uint32_t touchedPages[kMaxTouchedPages] = {};
+    uint32_t numTouchedPages = 0;
+    bool touchedOverflow = false;
+    uint64_t residentAccesses = 0;
+
+    // Set by a handler that could not complete; the pc is left on it
+    MemoryFault fault = MemoryFault::None;
+    uint32_t faultAddress = 0;
+
+    // Set by FORK; the owner clones the process and clears it
+    bool forkPending = false;
+
+    // Absorbs variables past the end of the symbol table
+    uint16_t scratch = 0;
+};
+
+class Interpreter {
+public:
+    enum class StepResult {
+        Executed,
+        Sleeping,
+        PageFault,
+        AccessViolation,
+        Forked,
+        Finished
+    };
+
+    // Executes exactly one instruction line, or burns one tick of SLEEP.
+    // A faulting instruction has no effect and is retried on the next step.
+    // Returns Forked instead of Executed when the line was a FORK.
+    static StepResult step(ExecutionContext& ctx);
+
+    // Runs up to maxLines instruction lines through the fused fast path
+    // without honoring SLEEP ticks. Stops early on a memory fault, or
+    // after a FORK with ctx.forkPending left set for the caller.
+    // Returns the number of lines retired.
+    static uint64_t run(ExecutionContext& ctx, uint64_t maxLines = UINT64_MAX);
+
+    static bool hasRemainingWork(const ExecutionContext& ctx);
+
+    // Points the context at an address space split into 2^pageShift-byte
+    // pages (pageShift < 32). The symbol table occupies its first bytes.
+    static void attachMemory(ExecutionContext& ctx, SparseTable<PageSlot>* pageTable,
+        uint32_t pageShift, uint32_t addressLimit);
+
+    // Handler lookup used when building and optimizing programs
+    static InstructionHandler handlerFor(OpCode op);
+    static InstructionHandler specializedHandlerFor(const Instruction& ins);
+    static InstructionHandler fusedHandlerFor(OpCode first, OpCode second);
+    static InstructionHandler cachedLoopHandler();
+    static bool isStraightLine(OpCode op);
+    static bool isCountedLine(OpCode op);     // retires a line when executed
+};
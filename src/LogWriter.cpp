@@ -0,0 +1,349 @@
+#include "LogWriter.h"
+#include "Process.h"
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+constexpr int LogWriter::kMaxCores;
+constexpr size_t LogWriter::kRingCapacity;
+constexpr size_t TextLogFiles::kFlushBytes;
+constexpr size_t TextLogFiles::kMaxOpenFiles;
+
+namespace {
+
+// How often the writer wakes to drain the rings, and how often buffered
+// text is pushed to disk even when no file's buffer has filled up
+const std::chrono::milliseconds kDrainInterval(10);
+const std::chrono::milliseconds kFlushInterval(100);
+
+// A process that migrates cores can have an older record still sitting in
+// the ring the writer has already drained this pass. Records younger than
+// this are held back a pass so every process's lines stay in order.
+const std::chrono::milliseconds kSettleTime(20);
+
+} // namespace
+
+bool LogWriter::Ring::push(LogRecord&& record) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cachedHead == kRingCapacity) {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (t - cachedHead == kRingCapacity) {
+            return false;
+        }
+    }
+    slots[t & (kRingCapacity - 1)] = std::move(record);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogWriter::Ring::pop(LogRecord& record) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record = std::move(slots[h & (kRingCapacity - 1)]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+LogWriter& LogWriter::getInstance() {
+    static LogWriter instance;
+    return instance;
+}
+
+LogWriter::LogWriter()
+    : numDropped(0), running(false), format(LogFormat::Text) {
+    for (auto& ring : coreRings) {
+        ring.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LogWriter::~LogWriter() {
+    stop();
+    for (auto& ring : coreRings) {
+        delete ring.load(std::memory_order_relaxed);
+    }
+}
+
+void LogWriter::start(LogFormat format) {
+    if (running.load() && this->format != format) {
+        stop();
+    }
+
+    std::lock_guard<std::mutex> lock(lifecycleMutex);
+    if (running.load()) {
+        return;
+    }
+    if (format == LogFormat::Binary && !binaryLog.open()) {
+        std::cerr << "Unable to create binary log segment; logging as text.\n";
+        format = LogFormat::Text;
+    }
+    this->format = format;
+
+    // Records a core queued after the last stop belong to no session
+    LogRecord stale;
+    for (auto& slot : coreRings) {
+        Ring* ring = slot.load(std::memory_order_acquire);
+        if (ring == nullptr) continue;
+        while (ring->pop(stale)) {}
+    }
+    while (sharedRing.pop(stale)) {}
+
+    running.store(true);
+    writerThread = std::thread(&LogWriter::writerLoop, this);
+}
+
+void LogWriter::stop() {
+    std::lock_guard<std::mutex> lock(lifecycleMutex);
+    if (!running.load()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> wakeLock(wakeMutex);
+        running.store(false);
+    }
+    wakeCondition.notify_all();
+    writerThread.join();
+}
+
+LogFormat LogWriter::getFormat() const {
+    return format;
+}
+
+void LogWriter::append(int coreId, LogRecord&& record) {
+    record.time = std::chrono::system_clock::now();
+    record.coreId = coreId;
+    submit(coreId, std::move(record));
+}
+
+uint64_t LogWriter::getNumDropped() const {
+    return numDropped.load(std::memory_order_relaxed);
+}
+
+void LogWriter::submit(int coreId, LogRecord&& record) {
+    Ring* ring = ringFor(coreId);
+    bool accepted;
+    if (ring != nullptr) {
+        accepted = ring->push(std::move(record));
+    }
+    else {
+        std::lock_guard<std::mutex> lock(sharedRingMutex);
+        accepted = sharedRing.push(std::move(record));
+    }
+    if (!accepted) {
+        // The writer is behind; never make the core wait for the disk
+        numDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+LogWriter::Ring* LogWriter::ringFor(int coreId) {
+    if (coreId < 0 || coreId >= kMaxCores) {
+        return nullptr;
+    }
+    Ring* ring = coreRings[coreId].load(std::memory_order_acquire);
+    if (ring == nullptr) {
+        // Only this core's worker produces into the slot, but the CAS keeps
+        // a restarted scheduler from racing the previous one
+        Ring* created = new Ring();
+        if (coreRings[coreId].compare_exchange_strong(ring, created, std::memory_order_acq_rel)) {
+            ring = created;
+        }
+        else {
+            delete created;
+        }
+    }
+    return ring;
+}
+
+void LogWriter::writerLoop() {
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    while (running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait_for(lock, kDrainInterval, [this]() { return !running.load(); });
+        }
+
+        drainRings();
+        writeSettled(false);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush >= kFlushInterval) {
+            flushOutput();
+            lastFlush = now;
+        }
+    }
+
+    drainRings();
+    writeSettled(true);
+    closeOutput();
+}
+
+void LogWriter::drainRings() {
+    LogRecord record;
+    for (auto& slot : coreRings) {
+        Ring* ring = slot.load(std::memory_order_acquire);
+        if (ring == nullptr) continue;
+        while (ring->pop(record)) {
+            pending.push_back(std::move(record));
+        }
+    }
+    // Producers on the shared ring are serialized by its mutex, so the
+    // writer is still its only consumer
+    while (sharedRing.pop(record)) {
+        pending.push_back(std::move(record));
+    }
+}
+
+void LogWriter::writeSettled(bool all) {
+    if (pending.empty()) {
+        return;
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const LogRecord& a, const LogRecord& b) {
+        if (a.processName != b.processName) return a.processName < b.processName;
+        return a.sequence < b.sequence;
+    });
+
+    auto cutoff = std::chrono::system_clock::now() - kSettleTime;
+    std::vector<LogRecord> held;
+    for (size_t i = 0; i < pending.size(); ) {
+        size_t end = i;
+        while (end < pending.size() && pending[end].processName == pending[i].processName) {
+            end++;
+        }
+        // Once one of a process's records is too young, everything after it waits too
+        size_t j = i;
+        while (j < end && (all || pending[j].time <= cutoff)) {
+            writeRecord(pending[j]);
+            j++;
+        }
+        for (; j < end; ++j) {
+            held.push_back(std::move(pending[j]));
+        }
+        i = end;
+    }
+    pending.swap(held);
+}
+
+void LogWriter::writeRecord(const LogRecord& record) {
+    if (format == LogFormat::Binary) {
+        binaryLog.append(record);
+    }
+    else {
+        textFiles.write(record);
+    }
+}
+
+void LogWriter::flushOutput() {
+    if (format == LogFormat::Binary) {
+        binaryLog.flush();
+    }
+    else {
+        textFiles.flushAll();
+    }
+}
+
+void LogWriter::closeOutput() {
+    if (format == LogFormat::Binary) {
+        binaryLog.close();
+    }
+    else {
+        textFiles.closeAll();
+    }
+}
+
+TextLogFiles::TextLogFiles()
+    : cachedSecond(0) {}
+
+void TextLogFiles::write(const LogRecord& record) {
+    OpenFile* file = openFile(record.processName, record.header);
+    if (file == nullptr) {
+        return;
+    }
+
+    if (record.header) {
+        file->buffer += "Process name: " + record.processName + "\nLogs:\n";
+    }
+    else {
+        file->buffer += formatTime(record.time);
+        file->buffer += "Core:" + std::to_string(record.coreId) + " \"";
+        Process::appendExpanded(file->buffer, record.message, record.processName);
+        if (record.hasArgument) {
+            file->buffer += std::to_string(record.argument);
+        }
+        file->buffer += "\"\n";
+    }
+
+    if (file->buffer.size() >= kFlushBytes) {
+        flushFile(*file);
+    }
+}
+TextLogFiles::OpenFile* TextLogFiles::openFile(const std::string& processName, bool truncate) {
+    auto it = openFiles.find(processName);
+    if (it != openFiles.end()) {
+        lru.splice(lru.end(), lru, it->second.lruPosition);
+        if (!truncate) {
+            return &it->second;
+        }
+        // A new process reused the name; start its file over
+        it->second.buffer.clear();
+        it->second.stream.close();
+        it->second.stream.open(processName + ".txt", std::ios::out | std::ios::trunc);
+        return &it->second;
+    }
+
+    if (openFiles.size() >= kMaxOpenFiles) {
+        auto oldest = openFiles.find(lru.front());
+        flushFile(oldest->second);
+        openFiles.erase(oldest);
+        lru.pop_front();
+    }
+
+    OpenFile& file = openFiles[processName];
+    file.stream.open(processName + ".txt", std::ios::out | (truncate ? std::ios::trunc : std::ios::app));
+    if (!file.stream.is_open()) {
+        std::cerr << "Unable to open log file for process " << processName << std::endl;
+        openFiles.erase(processName);
+        return nullptr;
+    }
+    file.lruPosition = lru.insert(lru.end(), processName);
+    return &file;
+}
+
+void TextLogFiles::flushFile(OpenFile& file) {
+    if (!file.buffer.empty()) {
+        file.stream.write(file.buffer.data(), static_cast<std::streamsize>(file.buffer.size()));
+        file.buffer.clear();
+    }
+    file.stream.flush();
+}
+
+void TextLogFiles::flushAll() {
+    for (auto& pair : openFiles) {
+        flushFile(pair.second);
+    }
+}
+
+void TextLogFiles::closeAll() {
+    flushAll();
+    openFiles.clear();
+    lru.clear();
+}
+
+const std::string& TextLogFiles::formatTime(std::chrono::system_clock::time_point time) {
+    // Lines arrive in bursts within the same second; format each second once
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    if (seconds != cachedSecond || cachedTime.empty()) {
+        std::tm localTime;
+        localtime_s(&localTime, &seconds);
+
+        std::ostringstream oss;
+        oss << "(" << std::put_time(&localTime, "%m/%d/%Y %I:%M:%S%p") << ") ";
+        cachedTime = oss.str();
+        cachedSecond = seconds;
+    }
+    return cachedTime;
+}
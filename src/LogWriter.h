@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "BinaryLog.h"
+
+// One process log line, stamped on the core that produced it
+struct LogRecord {
+    std::string processName;
+    std::string message;
+    std::chrono::system_clock::time_point time;
+    int processId = 0;
+    uint32_t sequence = 0;          // per-process order across core migrations
+    uint32_t instructionIndex = 0;  // lines the process had retired
+    uint32_t argument = 0;          // printed after message when hasArgument
+    int coreId = -1;
+    bool hasArgument = false;
+    bool header = false;            // starts a fresh log file for the process
+};
+
+enum class LogFormat {
+    Text,       // <process name>.txt per process
+    Binary      // fixed-size records in mapped segment files; see BinaryLog
+};
+
+// The per-process text files: kept open up to a limit and written in
+// buffered batches. Used by the log writer in text mode and by the binary
+// log decoder.
+class TextLogFiles {
+public:
+    static constexpr size_t kFlushBytes = 16 * 1024;    // per-file buffer before it is written
+    static constexpr size_t kMaxOpenFiles = 256;
+
+    TextLogFiles();
+
+    void write(const LogRecord& record);
+    void flushAll();
+    void closeAll();
+
+private:
+    struct OpenFile {
+        std::ofstream stream;
+        std::string buffer;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    OpenFile* openFile(const std::string& processName, bool truncate);
+    void flushFile(OpenFile& file);
+    const std::string& formatTime(std::chrono::system_clock::time_point time);
+
+    std::unordered_map<std::string, OpenFile> openFiles;
+    std::list<std::string> lru;     // least recently written at the front
+    std::time_t cachedSecond;
+    std::string cachedTime;
+};
+
+// Asynchronous writer for process logs. Each core appends records to its
+// own single-producer ring without locking or touching the disk; a
+// background thread drains the rings and writes them out in the selected
+// format, flushing on a size or time threshold. When a ring is full the
+// record is dropped and counted rather than blocking the worker.
+class LogWriter {
+public:
+    static constexpr int kMaxCores = 128;
+    static constexpr size_t kRingCapacity = 4096;       // records per core, a power of two
+
+    static LogWriter& getInstance();
+
+    // Restarts the writer if it is already running in another format
+    void start(LogFormat format = LogFormat::Text);
+    void stop();    // drains every ring, flushes and closes all files
+    LogFormat getFormat() const;
+
+    // Safe from any thread. Records from coreId in [0, kMaxCores) must
+    // come from one thread at a time, which is how scheduler workers run;
+    // anything else goes through a shared ring guarded by a mutex.
+    // The record is timestamped here.
+    void append(int coreId, LogRecord&& record);
+
+    uint64_t getNumDropped() const;
+
+private:
+    // Bounded single-producer, single-consumer queue. Head and tail are
+    // padded onto separate cache lines so the producing core and the
+    // writer do not bounce each other's line.
+    struct Ring {
+        LogRecord slots[kRingCapacity];
+        std::atomic<size_t> head{ 0 };     // next slot to read
+        char headPadding[64];
+        std::atomic<size_t> tail{ 0 };     // next slot to write
+        size_t cachedHead = 0;              // producer's last view of head
+
+        bool push(LogRecord&& record);
+        bool pop(LogRecord& record);
+    };
+
+    LogWriter();
+    ~LogWriter();
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    void submit(int coreId, LogRecord&& record);
+    Ring* ringFor(int coreId);
+
+    void writerLoop();
+    void drainRings();
+    void writeSettled(bool all);
+    void writeRecord(const LogRecord& record);
+    void flushOutput();
+    void closeOutput();
+
+    std::atomic<Ring*> coreRings[kMaxCores];
+    Ring sharedRing;
+    std::mutex sharedRingMutex;
+    std::atomic<uint64_t> numDropped;
+
+    std::thread writerThread;
+    std::atomic<bool> running;
+    LogFormat format;
+    std::mutex lifecycleMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+
+    // Writer-thread state
+    std::vector<LogRecord> pending;
+    TextLogFiles textFiles;
+    BinaryLogWriter binaryLog;
+};
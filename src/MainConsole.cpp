@@ -2,14 +2,22 @@
 #include "ConsoleManager.h"
 #include "Process.h"
 #include "Screen.h"
+#include "Interpreter.h"
+#include "InstructionGenerator.h"
+#include "LogWriter.h"
+#include "ProcessWatch.h"
+#include "Tlb.h"
+#include "Tracer.h"
+#include <chrono>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <fstream>
 #include <iomanip>
 #include <ctime>
 
 MainConsole::MainConsole(ConsoleManager& manager)
-    : consoleManager(manager) {}
+    : consoleManager(manager), reportWriter(manager) {}
 
 void MainConsole::run() {
     consoleManager.setCurrentPrompt("Main> ");
@@ -20,6 +28,7 @@ void MainConsole::run() {
 
         if (input == "exit") {
             std::cout << "Ending processes and stopping scheduler..." << std::endl;
+            reportWriter.wait();
             if (consoleManager.isInitialized()) {
                 consoleManager.stopSchedulerTest();
                 consoleManager.stopScheduler();
@@ -78,7 +87,25 @@ void MainConsole::handleCommand(const std::string& input) {
         std::string flag = tokens[1];
 
         if (flag == "-s") {
-            if (tokens.size() >= 3) {
+            if (tokens.size() >= 5 && tokens[3] == "--from") {
+                std::string processName = tokens[2];
+                ConsoleManager::ProcessHold hold(consoleManager);
+                Process* parent = consoleManager.getProcess(tokens[4]);
+                if (!parent) {
+                    return;
+                }
+                if (parent->isCompleted()) {
+                    std::cout << "Process '" << tokens[4] << "' has finished and cannot be cloned.\n";
+                    return;
+                }
+                if (consoleManager.forkProcess(parent, processName)) {
+                    std::cout << "Process '" << processName << "' cloned from '" << tokens[4] << "'.\n";
+                }
+                else {
+                    std::cout << "Could not clone '" << tokens[4] << "' as '" << processName << "'.\n";
+                }
+            }
+            else if (tokens.size() >= 3) {
                 std::string processName = tokens[2];
                 consoleManager.createProcess(processName);
                 std::cout << "Process '" << processName << "' created.\n";
@@ -89,11 +116,7 @@ void MainConsole::handleCommand(const std::string& input) {
         }
         else if (flag == "-r") {
             if (tokens.size() >= 3) {
-                std::string processName = tokens[2];
-                Process* process = consoleManager.getProcess(processName);
-                if (process) {
-                    consoleManager.switchToScreen(process);
-                }
+                consoleManager.switchToScreen(tokens[2]);
             }
             else {
                 std::cout << "Please specify a process name to resume.\n";
@@ -111,6 +134,7 @@ void MainConsole::handleCommand(const std::string& input) {
                 return;
             }
 
+            ConsoleManager::ProcessHold hold(consoleManager);
             auto runningProcessesMap = scheduler->getRunningProcesses();
             auto queuedProcesses = scheduler->getQueuedProcesses();
             auto finishedProcesses = scheduler->getFinishedProcesses();
@@ -140,19 +164,65 @@ void MainConsole::handleCommand(const std::string& input) {
 
             displayFinishedProcesses(finishedProcesses);
 
+            size_t numArchived = consoleManager.getProcessArchive().size();
+            if (numArchived > 0) {
+                std::cout << "(" << numArchived << " older finished processes archived; see report-util)\n";
+            }
+
             std::cout << "-------------------------------------------------------\n\n";
         }
         else {
             std::cout << "Invalid flag for screen command.\n";
             std::cout << "Usage:\n";
             std::cout << "  screen -s [process_name]       : Start a new process\n";
+            std::cout << "  screen -s [new] --from [name]  : Clone a running process copy-on-write\n";
             std::cout << "  screen -r [process_name]       : Resume an existing process\n";
             std::cout << "  screen -ls                     : List running and finished processes\n";
             std::cout << "  screen -ls -a                  : List all processes including queued\n";
         }
     }
     else if (command == "process-smi") {
-        displayProcessSmi();
+        if (tokens.size() == 1) {
+            displayProcessSmi();
+            return;
+        }
+
+        const char* usage = "Usage: process-smi [-w <ms> [-s cpu|mem] [-n <rows>]]\n";
+        long long intervalMs = 0;
+        ProcessWatch::SortKey sortKey = ProcessWatch::SortKey::Cpu;
+        size_t numRows = 20;
+        try {
+            for (size_t i = 1; i < tokens.size(); ++i) {
+                if (i + 1 >= tokens.size()) throw std::invalid_argument(tokens[i]);
+                const std::string& value = tokens[++i];
+                if (tokens[i - 1] == "-w") {
+                    intervalMs = std::stoll(value);
+                }
+                else if (tokens[i - 1] == "-s" && (value == "cpu" || value == "mem")) {
+                    sortKey = value == "cpu" ? ProcessWatch::SortKey::Cpu : ProcessWatch::SortKey::Memory;
+                }
+                else if (tokens[i - 1] == "-n") {
+                    numRows = static_cast<size_t>(std::stoul(value));
+                }
+                else {
+                    throw std::invalid_argument(value);
+                }
+            }
+        }
+        catch (const std::exception&) {
+            std::cout << usage;
+            return;
+        }
+        if (intervalMs <= 0 || numRows == 0 || numRows > 200) {
+            std::cout << usage;
+            return;
+        }
+        if (!consoleManager.getScheduler()) {
+            std::cout << "Scheduler is not initialized.\n";
+            return;
+        }
+        ProcessWatch watch(consoleManager, sortKey, numRows);
+        watch.run(std::chrono::milliseconds(intervalMs));
     }
     else if (command == "vmstat") {
         displayVmStat();
@@ -207,27 +277,118 @@ void MainConsole::handleCommand(const std::string& input) {
         consoleManager.stopSchedulerTest();
     }
     else if (command == "report-util") {
-        reportUtil();
+        bool incremental = false;
+        bool background = false;
+        for (size_t i = 1; i < tokens.size(); ++i) {
+            if (tokens[i] == "-i" || tokens[i] == "--incremental") {
+                incremental = true;
+            }
+            else if (tokens[i] == "-b" || tokens[i] == "--background") {
+                background = true;
+            }
+            else {
+                std::cout << "Usage: report-util [-i|--incremental] [-b|--background]\n";
+                return;
+            }
+        }
+        reportUtil(incremental, background);
     }
     else if (command == "log") {
         if (tokens.size() >= 2) {
             std::string option = tokens[1];
             if (option == "on") {
-                Process::setLoggingEnabled(true);
-                std::cout << "Process logging enabled.\n";
+                bool binary = tokens.size() >= 3 && tokens[2] == "binary";
+                if (tokens.size() >= 3 && !binary && tokens[2] != "text") {
+                    std::cout << "Usage: log on [text|binary]\n";
+                    return;
+                }
+                Process::setLoggingEnabled(true, binary);
+                if (LogWriter::getInstance().getFormat() == LogFormat::Binary) {
+                    std::cout << "Process logging enabled (binary segments; use 'log decode' to read them).\n";
+                }
+                else {
+                    std::cout << "Process logging enabled.\n";
+                }
             }
             else if (option == "off") {
                 Process::setLoggingEnabled(false);
                 std::cout << "Process logging disabled.\n";
+                uint64_t dropped = LogWriter::getInstance().getNumDropped();
+                if (dropped > 0) {
+                    std::cout << dropped << " log records were dropped while the writer was behind.\n";
+                }
+            }
+            else if (option == "decode") {
+                if (Process::isLoggingEnabled() && LogWriter::getInstance().getFormat() == LogFormat::Binary) {
+                    std::cout << "Turn logging off before decoding the binary log.\n";
+                    return;
+                }
+                std::string processName = tokens.size() >= 3 ? tokens[2] : "";
+                long long rendered = BinaryLogDecoder::decode(processName);
+                if (rendered < 0) {
+                    std::cout << "No binary log found.\n";
+                }
+                else {
+                    std::cout << "Decoded " << rendered << " log records into per-process text files.\n";
+                }
             }
             else {
-                std::cout << "Usage: log [on|off]\n";
+                std::cout << "Usage: log [on [text|binary]|off|decode [process_name]]\n";
             }
         }
         else {
-            std::cout << "Usage: log [on|off]\n";
+            std::cout << "Usage: log [on [text|binary]|off|decode [process_name]]\n";
         }
     }
+    else if (command == "trace") {
+        std::string option = tokens.size() >= 2 ? tokens[1] : "";
+        if (option == "on") {
+            Tracer::getInstance().start();
+            std::cout << "Scheduler tracing enabled.\n";
+        }
+        else if (option == "off") {
+            Tracer::getInstance().stop();
+            std::cout << "Scheduler tracing disabled.\n";
+        }
+        else if (option == "export") {
+            std::string path = tokens.size() >= 3 ? tokens[2] : "trace.json";
+
+            // Archived names first, so a PID reused by a live process shows its current name
+            std::unordered_map<int, std::string> names;
+            ConsoleManager::ProcessHold hold(consoleManager);
+            for (const ProcessSummary& summary : consoleManager.getProcessArchive().getSummaries()) {
+                names[summary.id] = summary.name;
+            }
+            for (Process* process : consoleManager.getProcessSnapshot()) {
+                names[process->getId()] = process->getName();
+            }
+
+            long long written = Tracer::getInstance().exportChromeTrace(path, names);
+            if (written < 0) {
+                std::cout << "Unable to write " << path << "\n";
+            }
+            else {
+                std::cout << "Wrote " << written << " trace events to " << path
+                    << " (tracing stopped; open it in Perfetto or chrome://tracing).\n";
+            }
+        }
+        else {
+            std::cout << "Usage: trace [on|off|export [file]]\n";
+        }
+    }
+    else if (command == "interp-bench") {
+        unsigned long long numInstructions = 10000000ULL;
+        if (tokens.size() >= 2) {
+            try {
+                numInstructions = std::stoull(tokens[1]);
+            }
+            catch (const std::exception&) {
+                std::cout << "Usage: interp-bench [instructions]\n";
+                return;
+            }
+        }
+        runInterpreterBenchmark(numInstructions);
+    }
     else if (command == "initialize") {
         std::cout << "System is already initialized.\n";
     }
@@ -322,8 +483,77 @@ void MainConsole::displayVmStat() {
             << std::string(2, ' ') << "|\n";
         std::cout << "| Pages Out     : " << std::right << std::setw(13) << memoryManager.getNumPagedOut()
             << std::string(2, ' ') << "|\n";
+        std::cout << "| Replacement   : " << std::right << std::setw(13) << memoryManager.getReplacementPolicyName()
+            << std::string(2, ' ') << "|\n";
+        std::cout << "| Hit Ratio     : " << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+            << memoryManager.getPageHitRatio() << "%" << std::string(2, ' ') << "|\n";
+        std::cout << "| Faults/1K Ref : " << std::right << std::setw(13) << std::fixed << std::setprecision(2)
+            << memoryManager.getPageFaultRate() << std::string(2, ' ') << "|\n";
+    }
+    else {
+        std::cout << "+--------------------------------+\n";
+        std::cout << "| Allocator:                     |\n";
+        std::cout << "| Type          : " << std::right << std::setw(13) << memoryManager.getAllocatorName()
+            << std::string(2, ' ') << "|\n";
+        std::cout << "| Internal Frag : " << std::right << std::setw(10) << memoryManager.getInternalFragmentation()
+            << " KB" << std::string(2, ' ') << "|\n";
+        std::cout << "| Free Blocks   : " << std::right << std::setw(13) << memoryManager.getNumFreeBlocks()
+            << std::string(2, ' ') << "|\n";
+        std::cout << "| Largest Free  : " << std::right << std::setw(10) << memoryManager.getLargestFreeBlock()
+            << " KB" << std::string(2, ' ') << "|\n";
+        std::cout << "| Avg Alloc (ns): " << std::right << std::setw(13) << memoryManager.getAverageAllocationNanos()
+            << std::string(2, ' ') << "|\n";
+        std::cout << "| Blocks Moved  : " << std::right << std::setw(13) << memoryManager.getNumCompactionMoves()
+            << std::string(2, ' ') << "|\n";
+        std::cout << "| Bytes Moved   : " << std::right << std::setw(10) << memoryManager.getBytesCompacted()
+            << " KB" << std::string(2, ' ') << "|\n";
     }
 
+    std::cout << "+--------------------------------+\n";
+    std::cout << "| Page Faults:                   |\n";
+    std::cout << "| Faults        : " << std::right << std::setw(13) << memoryManager.getNumPageFaults()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Store Reads   : " << std::right << std::setw(13) << memoryManager.getNumBackingStoreReads()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Store Writes  : " << std::right << std::setw(13) << memoryManager.getNumBackingStoreWrites()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Swap Used     : " << std::right << std::setw(10) << memoryManager.getSwapUsed()
+        << " KB" << std::string(2, ' ') << "|\n";
+    std::cout << "| Swap Size     : " << std::right << std::setw(10) << memoryManager.getSwapSize()
+        << " KB" << std::string(2, ' ') << "|\n";
+    if (memoryManager.isSwapPoolEnabled()) {
+        std::cout << "| Pool Used     : " << std::right << std::setw(10) << memoryManager.getSwapPoolUsed()
+            << " KB" << std::string(2, ' ') << "|\n";
+        std::cout << "| Pool Ratio    : " << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+            << memoryManager.getSwapPoolRatio() << "x" << std::string(2, ' ') << "|\n";
+        std::cout << "| Pool Hits     : " << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+            << memoryManager.getSwapPoolHitRatio() << "%" << std::string(2, ' ') << "|\n";
+    }
+    std::cout << "| Blocked Faults: " << std::right << std::setw(13) << memoryManager.getNumBlockedFaults()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Read-Ahead    : " << std::right << std::setw(13) << memoryManager.getNumReadAheadPages()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Write Batches : " << std::right << std::setw(13) << memoryManager.getNumWriteBatches()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| COW Faults    : " << std::right << std::setw(13) << memoryManager.getNumCowFaults()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Forks         : " << std::right << std::setw(13) << memoryManager.getNumForks()
+        << std::string(2, ' ') << "|\n";
+    std::cout << "| Shared Frames : " << std::right << std::setw(13) << memoryManager.getNumSharedFrames()
+        << std::string(2, ' ') << "|\n";
+
+    std::cout << "+--------------------------------+\n";
+    std::cout << "| TLB Hit Rate:                  |\n";
+    for (int core = 0; core < Tlb::getNumCoresUsed(); ++core) {
+        const Tlb* tlb = Tlb::forCore(core);
+        uint64_t lookups = tlb->getHits() + tlb->getMisses();
+        double hitRate = lookups > 0 ? 100.0 * tlb->getHits() / lookups : 0.0;
+        std::cout << "| Core " << std::left << std::setw(9) << core << ": " << std::right << std::setw(12)
+            << std::fixed << std::setprecision(2) << hitRate << "%" << std::string(2, ' ') << "|\n";
+    }
+    std::cout << "| Shootdowns    : " << std::right << std::setw(13) << Tlb::getNumShootdowns()
+        << std::string(2, ' ') << "|\n";
+
     std::cout << "+--------------------------------+\n\n";
 }
 
@@ -412,131 +642,66 @@ void MainConsole::displayQueuedProcesses(const std::vector<Process*>& queuedProc
     }
 }
 
-void MainConsole::reportUtil() {
-    Scheduler* scheduler = consoleManager.getScheduler();
-    if (!scheduler) {
+void MainConsole::reportUtil(bool incremental, bool background) {
+    if (!consoleManager.getScheduler()) {
         std::cout << "Scheduler is not initialized.\n";
         return;
     }
-
-    auto runningProcessesMap = scheduler->getRunningProcesses();
-    auto queuedProcesses = scheduler->getQueuedProcesses();
-    auto finishedProcesses = scheduler->getFinishedProcesses();
-
-    std::vector<Process*> runningProcesses;
-    for (const auto& pair : runningProcessesMap) {
-        runningProcesses.push_back(pair.first);
+    if (!reportWriter.write(incremental, background)) {
+        std::cout << "A background report is still being written to " << reportWriter.getFilename() << ".\n";
     }
-
-    std::ofstream logfile("csopesy-log.txt", std::ios::app);
-
-    if (!logfile.is_open()) {
-        std::cout << "Failed to open csopesy-log.txt for writing.\n";
-        return;
+    else if (background) {
+        std::cout << "Writing utilization report in the background.\n";
     }
+}
 
-    std::time_t now = std::time(nullptr);
-    char buffer[26];
-    ctime_s(buffer, sizeof(buffer), &now);
-    logfile << "Report generated at: " << buffer << "\n";
-
-    // Display CPU utilization and core information
-    int totalCores = scheduler->getTotalCores();
-    int busyCores = scheduler->getBusyCores();
-    int availableCores = totalCores - busyCores;
-    double cpuUtilization = ((double)busyCores / totalCores) * 100.0;
-
-    logfile << "CPU utilization: " << std::fixed << std::setprecision(2) << cpuUtilization << "%\n";
-    logfile << "Cores used: " << busyCores << "\n";
-    logfile << "Cores available: " << availableCores << "\n";
-
-    logfile << "\n-------------------------------------------------------";
-
-    // Display queued processes
-    if (!queuedProcesses.empty()) {
-        logfile << "\nQueued processes:\n";
-        for (Process* process : queuedProcesses) {
-            std::string processName = process->getName();
-            std::time_t creationTime = process->getCreationTime();
-            std::tm creationTm;
-
-            localtime_s(&creationTm, &creationTime);
-
-            char timeBuffer[30];
-            std::strftime(timeBuffer, sizeof(timeBuffer), "%m/%d/%Y %I:%M:%S%p", &creationTm);
-            std::string timeStr = timeBuffer;
-
-            int currentLine = process->getCurrentLine();
-            int totalLines = process->getTotalLines();
+void MainConsole::runInterpreterBenchmark(unsigned long long numInstructions) {
+    // Measures raw interpreter throughput on scheduler-test instruction mixes.
+    // SLEEP ticks and the per-cycle scheduler delay are not simulated here.
+    Config& config = Config::getInstance();
+    const int numPrograms = 16;
 
-            // Format: processName  (creationTime)  Queued   currentLine / totalLines
-            logfile << std::left << std::setw(15) << processName
-                << "(" << timeStr << ")    "
-                << "Queued     "
-                << currentLine << " / " << totalLines << "\n";
-        }
-    }
-    else {
-        logfile << "\nNo queued processes.\n";
+    std::vector<Program> programs(numPrograms);
+    for (int i = 0; i < numPrograms; ++i) {
+        unsigned int numIns = config.getMinIns() + rand() % (config.getMaxIns() - config.getMinIns() + 1);
+        InstructionGenerator::generate(programs[i], numIns, config.getMaxMemPerProc());
     }
 
-    // Display running processes
-    if (!runningProcesses.empty()) {
-        logfile << "\nRunning processes:\n";
-        for (Process* process : runningProcesses) {
-            int coreId = runningProcessesMap.at(process);
-            std::string processName = process->getName();
-            std::time_t creationTime = process->getCreationTime();
-            std::tm creationTm;
-
-            localtime_s(&creationTm, &creationTime);
-
-            char timeBuffer[30];
-            std::strftime(timeBuffer, sizeof(timeBuffer), "%m/%d/%Y %I:%M:%S%p", &creationTm);
-            std::string timeStr = timeBuffer;
-
-            int currentLine = process->getCurrentLine();
-            int totalLines = process->getTotalLines();
-
-            // Format: processName  (creationTime)  Core: coreId   currentLine / totalLines
-            logfile << std::left << std::setw(15) << processName
-                << "(" << timeStr << ")    "
-                << "Core: " << coreId << "     "
-                << currentLine << " / " << totalLines << "\n";
-        }
-    }
-    else {
-        logfile << "\nNo running processes.\n";
+    std::vector<Program> optimizedPrograms = programs;
+    for (Program& program : optimizedPrograms) {
+        program.optimize();
     }
 
-    // Display finished processes
-    if (!finishedProcesses.empty()) {
-        logfile << "\nFinished processes:\n";
-        for (Process* process : finishedProcesses) {
-            std::string processName = process->getName();
-            std::time_t creationTime = process->getCreationTime();
-            std::tm creationTm;
-
-            localtime_s(&creationTm, &creationTime);
-
-            char timeBuffer[30];
-            std::strftime(timeBuffer, sizeof(timeBuffer), "%m/%d/%Y %I:%M:%S%p", &creationTm);
-            std::string timeStr = timeBuffer;
-
-            int totalLines = process->getTotalLines();
+    std::cout << "Plain dispatch:\n";
+    benchmarkPrograms(programs, numInstructions);
+    std::cout << "Fused superinstructions:\n";
+    benchmarkPrograms(optimizedPrograms, numInstructions);
+}
 
-            // Format: processName  (creationTime)  Finished   totalLines / totalLines
-            logfile << std::left << std::setw(15) << processName
-                << "(" << timeStr << ")    "
-                << "Finished     "
-                << totalLines << " / " << totalLines << "\n";
-        }
+void MainConsole::benchmarkPrograms(const std::vector<Program>& programs, unsigned long long numInstructions) {
+    // Every program runs in one fully resident page, so no faults are taken
+    unsigned int memorySize = Config::getInstance().getMaxMemPerProc();
+    std::vector<uint8_t> memory(memorySize);
+    SparseTable<PageSlot> pageTable(1);
+    pageTable.at(0).base = memory.data();
+
+    unsigned long long retired = 0;
+    unsigned long long runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (retired < numInstructions) {
+        ExecutionContext ctx;
+        ctx.program = &programs[runs % programs.size()];
+        Interpreter::attachMemory(ctx, &pageTable, 31, memorySize);
+        retired += Interpreter::run(ctx);
+        runs++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "  Executed " << retired << " instructions across " << runs << " program runs in "
+        << std::fixed << std::setprecision(3) << seconds << " s\n";
+    if (seconds > 0.0) {
+        std::cout << "  Throughput: " << std::fixed << std::setprecision(2)
+            << (retired / seconds) / 1e6 << " M instructions/s\n";
     }
-    else {
-        logfile << "\nNo finished processes.\n";
-    }
-
-    logfile << "-------------------------------------------------------\n\n\n";
-    logfile.close();
-    std::cout << "Utilization report saved to csopesy-log.txt.\n";
 }
\ No newline at end of file
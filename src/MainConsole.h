@@ -1,12 +1,14 @@
 #pragma once
 
 #include "Console.h"
+#include "ReportWriter.h"
 #include <string>
 #include <vector>
 #include <map>
 
 class ConsoleManager;
 class Process;
+class Program;
 
 class MainConsole : public Console {
 public:
@@ -22,7 +24,10 @@ private:
     void displayFinishedProcesses(const std::vector<Process*>& finishedProcesses);
     void displayQueuedProcesses(const std::vector<Process*>& queuedProcesses);
 
-    void reportUtil();
+    void reportUtil(bool incremental, bool background);
+    void runInterpreterBenchmark(unsigned long long numInstructions);
+    void benchmarkPrograms(const std::vector<Program>& programs, unsigned long long numInstructions);
 
     ConsoleManager& consoleManager;
+    ReportWriter reportWriter;
 };
@@ -0,0 +1,237 @@
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : view(nullptr), length(0), writable(false),
+#ifdef _WIN32
+      file(INVALID_HANDLE_VALUE), mapping(nullptr)
+#else
+      fd(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::create(const std::string& path, size_t size) {
+    close();
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = static_cast<LONGLONG>(size);
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, fileSize.HighPart, fileSize.LowPart, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+    if (view == nullptr) {
+        close();
+        return false;
+    }
+    length = size;
+    writable = true;
+    return true;
+}
+
+bool MappedFile::openReadOnly(const std::string& path) {
+    close();
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (view == nullptr) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    writable = false;
+    return true;
+}
+
+bool MappedFile::resize(size_t size) {
+    if (view == nullptr || !writable) {
+        return false;
+    }
+    UnmapViewOfFile(view);
+    view = nullptr;
+    CloseHandle(mapping);
+    mapping = nullptr;
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = static_cast<LONGLONG>(size);
+    if (size < length) {
+        SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN);
+        SetEndOfFile(file);
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, fileSize.HighPart, fileSize.LowPart, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+    if (view == nullptr) {
+        close();
+        return false;
+    }
+    length = size;
+    return true;
+}
+
+void MappedFile::close(size_t finalSize) {
+    if (view != nullptr) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        if (writable && finalSize < length) {
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(finalSize);
+            SetFilePointerEx(file, position, nullptr, FILE_BEGIN);
+            SetEndOfFile(file);
+        }
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+    length = 0;
+    writable = false;
+}
+
+void MappedFile::flush() {
+    if (view != nullptr && writable) {
+        FlushViewOfFile(view, 0);
+    }
+}
+
+#else
+
+bool MappedFile::create(const std::string& path, size_t size) {
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close();
+        return false;
+    }
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(address);
+    length = size;
+    writable = true;
+    return true;
+}
+
+bool MappedFile::openReadOnly(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close();
+        return false;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(address);
+    length = static_cast<size_t>(info.st_size);
+    writable = false;
+    return true;
+}
+
+bool MappedFile::resize(size_t size) {
+    if (view == nullptr || !writable) {
+        return false;
+    }
+    munmap(view, length);
+    view = nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close();
+        return false;
+    }
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    view = static_cast<uint8_t*>(address);
+    length = size;
+    return true;
+}
+
+void MappedFile::close(size_t finalSize) {
+    if (view != nullptr) {
+        munmap(view, length);
+        view = nullptr;
+    }
+    if (fd >= 0) {
+        if (writable && finalSize < length) {
+            // On failure the file keeps its preallocated size; readers go by the header
+            int result = ftruncate(fd, static_cast<off_t>(finalSize));
+            (void)result;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    length = 0;
+    writable = false;
+}
+
+void MappedFile::flush() {
+    if (view != nullptr && writable) {
+        msync(view, length, MS_ASYNC);
+    }
+}
+
+#endif
+
+bool MappedFile::isOpen() const {
+    return view != nullptr;
+}
+
+uint8_t* MappedFile::data() const {
+    return view;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// A file mapped read-write into memory at a fixed, preallocated size
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Creates or truncates path, extends it to size bytes and maps it.
+    // The new contents read as zeros.
+    bool create(const std::string& path, size_t size);
+
+    // Maps an existing file read-only at its current size
+    bool openReadOnly(const std::string& path);
+
+    // Grows or shrinks a writable mapping to size bytes, keeping the
+    // contents that still fit. The view moves, so pointers into it go
+    // stale. On failure the file is left closed.
+    bool resize(size_t size);
+
+    // Unmaps and closes the file, first cutting it to finalSize bytes if
+    // that is smaller than the mapping
+    void close(size_t finalSize = SIZE_MAX);
+
+    // Asks the OS to write dirty pages back without waiting for them
+    void flush();
+
+    bool isOpen() const;
+    uint8_t* data() const;
+    size_t size() const;
+
+private:
+    uint8_t* view;
+    size_t length;
+    bool writable;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
@@ -1,16 +1,31 @@
 #include "MemoryManager.h"
-#include <fstream>
-#include <iostream>
+#include "Tracer.h"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+
+constexpr unsigned int MemoryManager::kIdleCompactionBlocks;
+constexpr unsigned int MemoryManager::kDemandCompactionBlocks;
+constexpr const char* MemoryManager::kSwapFile;
+constexpr unsigned int MemoryManager::kSwapTrimTicks;
+constexpr unsigned int MemoryManager::kSwapIoThreads;
+constexpr size_t MemoryManager::kWriteBatchPages;
+constexpr unsigned int MemoryManager::kWriteBehindTicks;
+constexpr size_t MemoryManager::kReadAheadPages;
 
 MemoryManager::MemoryManager()
     : maxMemory(0), memPerFrame(0), totalFrames(0), flatMemory(true),
-    usedMemory(0), numPagedIn(0), numPagedOut(0),
-    idleCpuTicks(0), activeCpuTicks(0), totalCpuTicks(0) {}
+    numFlatAllocations(0), flatAllocationNanos(0), numCompactionMoves(0), bytesCompacted(0),
+    numResidentAccesses(0), numBlockedFaults(0), numReadAheadPages(0), numPagedIn(0), numPagedOut(0),
+    numPageFaults(0), numCowFaults(0), numForks(0), idleCpuTicks(0), activeCpuTicks(0), totalCpuTicks(0),
+    swapIo(kSwapIoThreads) {}
 
 MemoryManager::~MemoryManager() {}
 
-void MemoryManager::initialize(unsigned int maxMem, unsigned int memPerFrame) {
+void MemoryManager::initialize(unsigned int maxMem, unsigned int memPerFrame, FitPolicy fitPolicy,
+    bool buddy, const std::string& replacementPolicy, unsigned int swapPoolSize) {
+    // In-flight transfers point into the frames and swap file replaced here
+    swapIo.drain();
     std::lock_guard<std::mutex> lock(memoryMutex);
 
     maxMemory = maxMem;
@@ -18,294 +33,580 @@ void MemoryManager::initialize(unsigned int maxMem, unsigned int memPerFrame) {
     totalFrames = maxMemory / memPerFrame;
     flatMemory = (maxMemory == memPerFrame);
 
+    frames = SparseTable<Frame>(totalFrames);
+
+    // Swap starts out as large as physical memory and grows on demand
+    backingStore.initialize(kSwapFile, memPerFrame, maxMemory);
+    // Flat mode swaps whole process images, which the pool is not meant for
+    swapPool.initialize(flatMemory ? 0 : swapPoolSize);
+    evictedPages.clear();
+
     if (flatMemory) {
         // Initialize single block of free memory
-        memoryBlocks.clear();
-        memoryBlocks.push_back({ 0, maxMemory, nullptr });
+        if (buddy) {
+            flatAllocator.reset(new BuddyAllocator(maxMemory));
+        }
+        else {
+            flatAllocator.reset(new FlatAllocator(maxMemory, fitPolicy));
+        }
+        numFlatAllocations = 0;
+        flatAllocationNanos = 0;
+        numCompactionMoves = 0;
+        bytesCompacted = 0;
     }
     else {
-        // Initialize frames for paging
-        frames.resize(totalFrames);
-        for (auto& frame : frames) {
-            frame.allocated = false;
-            frame.owner = nullptr;
-            frame.pageNumber = -1;
+        // Frame records are created as frames are first handed out
+        freeFrames.reset(totalFrames);
+
+        this->replacementPolicy = ReplacementPolicy::create(replacementPolicy, totalFrames);
+        if (!this->replacementPolicy) {
+            this->replacementPolicy = ReplacementPolicy::create("fifo", totalFrames);
         }
+        numResidentAccesses = 0;
     }
 }
 
-/*
-void MemoryManager::compactMemory() {
-    if (!flatMemory) return;
-
-    std::vector<MemoryBlock> newBlocks;
-    size_t currentOffset = 0;
+bool MemoryManager::compactMemory(unsigned int maxBlocks) {
+    if (!flatMemory || !flatAllocator) return false;
 
-    // Move all allocated blocks to the front
-    for (const auto& block : memoryBlocks) {
-        if (block.process != nullptr) {
-            newBlocks.push_back({ currentOffset, block.size, block.process });
-            currentOffset += block.size;
+    for (unsigned int moved = 0; moved < maxBlocks; ++moved) {
+        Process* owner;
+        size_t from, to, size;
+        if (!flatAllocator->compactStep(owner, from, to, size)) {
+            return moved > 0;
         }
+        // Blocks only ever move down, so the copy never outruns itself
+        owner->movePage(0, frameMemory(0) + to, size);
+        numCompactionMoves++;
+        bytesCompacted += size;
     }
+    return true;
+}
+
+void MemoryManager::removeOldestProcess() {
+    // Only flat memory evicts whole processes; paging replaces single pages
+    if (memoryQueue.empty()) return;
 
-    // Add remaining space as a single free block
-    if (currentOffset < maxMemory) {
-        newBlocks.push_back({ currentOffset, maxMemory - currentOffset, nullptr });
+    Process* oldestProcess = memoryQueue.front();
+    memoryQueue.pop_front();
+    memoryQueuePositions.erase(oldestProcess);
+
+    size_t offset, size;
+    if (flatAllocator->release(oldestProcess, offset, size)) {
+        // Keep the process's memory image so it can resume where it left off
+        if (oldestProcess->unmapPage(0)) {
+            backingStore.storePage(oldestProcess->getId(), 0, frameMemory(0) + offset, size);
+            submitWrites(false);
+        }
     }
 
-    memoryBlocks = std::move(newBlocks);
+    // Mark process as swapped out
+    swappedOutProcesses.insert(oldestProcess);
+    oldestProcess->setInMemory(false);
+}
+
+bool MemoryManager::allocateMemory(Process* process, unsigned int size) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return admitProcess(process, size);
 }
-*/
 
-bool MemoryManager::findFreeFrames(unsigned int numFramesNeeded, std::vector<int>& frameNumbers) {
-    frameNumbers.clear();
-    for (size_t i = 0; i < frames.size() && frameNumbers.size() < numFramesNeeded; ++i) {
-        if (!frames[i].allocated) {
-            frameNumbers.push_back(i);
+std::vector<Process*> MemoryManager::allocateMemoryBatch(const std::vector<Process*>& processes) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    std::vector<Process*> rejected;
+
+    if (!flatMemory) {
+        pageTables.reserve(pageTables.size() + processes.size());
+    }
+    for (Process* process : processes) {
+        unsigned int size = process->getMemorySize();
+        if (size > maxMemory) {
+            rejected.push_back(process);
+        }
+        else if (flatMemory) {
+            allocateFlatMemory(process, size, false);
+        }
+        else {
+            admitProcess(process, size);
         }
     }
-    return frameNumbers.size() == numFramesNeeded;
+    return rejected;
 }
 
-void MemoryManager::removeOldestProcess() {
-    if (memoryQueue.empty()) return;
-
-    Process* oldestProcess = memoryQueue.front();
-    memoryQueue.pop_front();
+bool MemoryManager::admitProcess(Process* process, unsigned int size) {
+    if (size > maxMemory) {
+        return false;
+    }
 
     if (flatMemory) {
-        for (auto& block : memoryBlocks) {
-            if (block.process == oldestProcess) {
-                block.process = nullptr;
-                usedMemory -= block.size;
-                break; // Assuming one block per process
-            }
+        return allocateFlatMemory(process, size);
+    }
+
+    // Demand paging: admission only builds the page table. Frames are
+    // assigned one page at a time by handlePageFault on first access.
+    if (pageTables.find(process) == pageTables.end()) {
+        process->initAddressSpace(memPerFrame);
+        unsigned int numPages = (size + memPerFrame - 1) / memPerFrame;
+        pageTables[process] = SparseTable<PageTableEntry>(numPages);
+    }
+    process->setInMemory(true);
+    return true;
+}
+
+bool MemoryManager::allocateFlatMemory(Process* process, unsigned int size, bool allowEviction) {
+    while (true) {
+        // Free blocks are always fully coalesced, so one lookup finds a fit if any exists
+        auto start = std::chrono::steady_clock::now();
+        size_t offset = flatAllocator->allocate(process, size);
+        flatAllocationNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        numFlatAllocations++;
+
+        if (offset != BlockAllocator::kNoSpace) {
+            memoryQueuePositions[process] = memoryQueue.insert(memoryQueue.end(), process);
+            assignFlatBlock(process, offset, size);
+            process->setInMemory(true);
+            return true;
         }
-        // Merge adjacent free blocks
-        mergeAdjacentFreeBlocks();
-
-        // Mark process as swapped out
-        swappedOutProcesses.insert(oldestProcess);
-        oldestProcess->setInMemory(false);
-
-        int processId = oldestProcess->getId();
-        std::string filename = std::to_string(processId) + ".txt";
-        std::ofstream outfile(filename);
-        if (outfile.is_open()) {
-            outfile << processId;
-            outfile.close();
+
+        // Enough memory may be free, just not in one piece. Compacting
+        // costs a copy of the moved blocks but keeps every process resident.
+        if (maxMemory - flatAllocator->getUsed() >= size && compactMemory(kDemandCompactionBlocks)) {
+            continue;
+        }
+
+        // No suitable contiguous free space found
+        // Attempt to remove oldest process
+        if (allowEviction && !memoryQueue.empty()) {
+            removeOldestProcess();
         }
         else {
-            std::cerr << "Failed to create backing store file for process " << processId << std::endl;
+            // No processes to remove, allocation fails
+            return false;
         }
     }
-    else {
-        auto it = pageTables.find(oldestProcess);
-        if (it != pageTables.end()) {
-            for (const auto& entry : it->second) {
-                if (entry.present) {
-                    frames[entry.frameNumber].allocated = false;
-                    frames[entry.frameNumber].owner = nullptr;
-                    frames[entry.frameNumber].pageNumber = -1;
-                    numPagedOut++;
-                }
-            }
-            pageTables.erase(it);
-        }
-        // Mark process as swapped out
-        swappedOutProcesses.insert(oldestProcess);
-        oldestProcess->setInMemory(false);
+}
+
+void MemoryManager::assignFlatBlock(Process* process, size_t offset, size_t size) {
+    // The whole block is a single page of the process's address space
+    process->initAddressSpace(static_cast<unsigned int>(size));
+    uint8_t* block = frameMemory(0) + offset;
+    if (!backingStore.loadPage(process->getId(), 0, block, size)) {
+        std::memset(block, 0, size);
     }
+    process->mapPage(0, block);
 }
 
-void MemoryManager::mergeAdjacentFreeBlocks() {
-    for (size_t i = 0; i < memoryBlocks.size() - 1; ) {
-        if (memoryBlocks[i].process == nullptr && memoryBlocks[i + 1].process == nullptr) {
-            // Merge blocks
-            memoryBlocks[i].size += memoryBlocks[i + 1].size;
-            memoryBlocks.erase(memoryBlocks.begin() + i + 1);
+FaultResult MemoryManager::handlePageFault(Process* process, uint32_t address) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    numPageFaults++;
+
+    if (flatMemory) {
+        if (process->isInMemory() || allocateFlatMemory(process, process->getMemorySize())) {
+            return FaultResult::Resolved;
         }
-        else {
-            ++i;
+        return FaultResult::Failed;
+    }
+
+    auto it = pageTables.find(process);
+    if (it == pageTables.end()) {
+        // Not admitted; the scheduler will allocate it again
+        return FaultResult::Failed;
+    }
+
+    unsigned int page = address / memPerFrame;
+    if (page >= it->second.size()) {
+        return FaultResult::Failed;
+    }
+    PageTableEntry& entry = it->second.at(page);
+    if (entry.present) {
+        // A fault on a resident page is a write to a copy-on-write page
+        if (process->isPageReadOnly(page) && !breakCopyOnWrite(process, page, entry)) {
+            return FaultResult::Failed;
         }
+        return FaultResult::Resolved;
+    }
+    if (entry.loading) {
+        // Read-ahead already has the page on its way
+        entry.waiting = true;
+        numBlockedFaults++;
+        return FaultResult::Blocked;
+    }
+
+    int frameNumber = takeFrame(ReplacementPolicy::pageKey(process->getId(), page));
+    if (frameNumber < 0) {
+        return FaultResult::Failed;
+    }
+    if (startPageIn(process, page, entry, frameNumber, true)) {
+        numBlockedFaults++;
+        return FaultResult::Blocked;
     }
+    return FaultResult::Resolved;
 }
 
-bool MemoryManager::allocateMemory(Process* process, unsigned int size) {
+void MemoryManager::setPageInHandler(std::function<void(Process*)> handler) {
     std::lock_guard<std::mutex> lock(memoryMutex);
+    pageInHandler = std::move(handler);
+}
 
-    if (size > maxMemory) {
+void MemoryManager::prefetch(Process* process) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    if (flatMemory) {
+        return;
+    }
+    auto evicted = evictedPages.find(process);
+    auto it = pageTables.find(process);
+    if (evicted == evictedPages.end() || it == pageTables.end()) {
+        return;
+    }
+
+    // Newest first, into free frames only: evicting for a guess would
+    // take frames from processes that are running now
+    std::deque<unsigned int>& pages = evicted->second;
+    while (!pages.empty()) {
+        unsigned int page = pages.back();
+        PageTableEntry* entry = it->second.find(page);
+        if (entry == nullptr || entry->present || entry->loading) {
+            pages.pop_back();
+            continue;
+        }
+        int frameNumber = freeFrames.allocate();
+        if (frameNumber < 0) {
+            return;
+        }
+        pages.pop_back();
+        startPageIn(process, page, *entry, frameNumber, false);
+        numReadAheadPages++;
+    }
+    evictedPages.erase(evicted);
+}
+
+void MemoryManager::waitForSwapIo() {
+    swapIo.drain();
+}
+
+bool MemoryManager::startPageIn(Process* process, unsigned int page, PageTableEntry& entry, int frameNumber, bool wake) {
+    // Bring the page in from the compressed pool or the backing store, or
+    // zero-fill it on first touch. Only a page that has reached the swap
+    // file needs real I/O.
+    uint8_t* data = frameMemory(frameNumber);
+    if (swapPool.loadPage(process->getId(), page, data, memPerFrame)) {
+        installPage(process, page, entry, frameNumber);
+        return false;
+    }
+    SwapIo::Request request;
+    SwapRead read = backingStore.beginRead(process->getId(), page, data, memPerFrame, request);
+    if (read != SwapRead::Queued) {
+        if (read == SwapRead::Missing) {
+            std::memset(data, 0, memPerFrame);
+        }
+        installPage(process, page, entry, frameNumber);
         return false;
     }
 
-    if (flatMemory) {
-        // Try to find a suitable free block or merge adjacent free blocks
-        while (true) {
-            for (size_t i = 0; i < memoryBlocks.size(); ++i) {
-                if (memoryBlocks[i].process == nullptr) {
-                    size_t combinedSize = memoryBlocks[i].size;
-                    size_t startIndex = i;
-                    size_t endIndex = i;
-
-                    // Check if current block is large enough
-                    if (combinedSize >= size) {
-                        // Allocate within this block
-                        if (combinedSize > size) {
-                            // Split the block
-                            MemoryBlock newBlock = {
-                                memoryBlocks[i].offset + size,
-                                memoryBlocks[i].size - size,
-                                nullptr
-                            };
-                            memoryBlocks.insert(memoryBlocks.begin() + i + 1, newBlock);
-                        }
-
-                        // Assign process to block
-                        memoryBlocks[i].size = size;
-                        memoryBlocks[i].process = process;
-                        usedMemory += size;
-                        memoryQueue.push_back(process);
-                        process->setInMemory(true);
-                        return true;
-                    }
+    // The frame is held for the page but stays out of the replacement
+    // policy, so nothing can evict it before the data arrives
+    Frame& frame = frames.at(frameNumber);
+    frame.allocated = true;
+    frame.owner = process;
+    frame.sharers.clear();
+    frame.pageNumber = page;
+    entry.frameNumber = frameNumber;
+    entry.loading = true;
+    entry.waiting = wake;
+
+    std::function<void()> unpin = std::move(request.complete);
+    request.complete = [this, process, page, frameNumber, unpin]() {
+        Process* woken;
+        std::function<void(Process*)> handler;
+        {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            unpin();
+            woken = finishPageIn(process, page, frameNumber);
+            handler = pageInHandler;
+        }
+        if (woken != nullptr && handler) {
+            handler(woken);
+        }
+    };
+    swapIo.submit(std::move(request));
+    return true;
+}
 
-                    // Try to merge adjacent free blocks
-                    for (size_t j = i + 1; j < memoryBlocks.size(); ++j) {
-                        if (memoryBlocks[j].process == nullptr &&
-                            memoryBlocks[j].offset == memoryBlocks[endIndex].offset + memoryBlocks[endIndex].size) {
-                            combinedSize += memoryBlocks[j].size;
-                            endIndex = j;
-
-                            if (combinedSize >= size) {
-                                // Merge blocks from startIndex to endIndex
-                                memoryBlocks[startIndex].size = combinedSize;
-                                memoryBlocks[startIndex].process = process;
-                                usedMemory += size;
-                                memoryQueue.push_back(process);
-                                process->setInMemory(true);
-
-                                // Remove merged blocks except the first one
-                                memoryBlocks.erase(memoryBlocks.begin() + startIndex + 1, memoryBlocks.begin() + endIndex + 1);
-
-                                // If there's extra space, split the block
-                                if (combinedSize > size) {
-                                    MemoryBlock newBlock = {
-                                        memoryBlocks[startIndex].offset + size,
-                                        combinedSize - size,
-                                        nullptr
-                                    };
-                                    memoryBlocks.insert(memoryBlocks.begin() + startIndex + 1, newBlock);
-                                    memoryBlocks[startIndex].size = size;
-                                }
-
-                                return true;
-                            }
-                        }
-                        else {
-                            // Can't merge non-adjacent blocks
-                            break;
-                        }
-                    }
-                }
-            }
+Process* MemoryManager::finishPageIn(Process* process, unsigned int page, int frameNumber) {
+    auto it = pageTables.find(process);
+    PageTableEntry* entry = it != pageTables.end() ? it->second.find(page) : nullptr;
+    if (entry == nullptr || !entry->loading || entry->frameNumber != frameNumber) {
+        // The process was torn down while the read was in flight
+        Frame& frame = frames.at(frameNumber);
+        frame.allocated = false;
+        frame.owner = nullptr;
+        frame.pageNumber = -1;
+        freeFrames.markFree(frameNumber);
+        return nullptr;
+    }
+    bool waiting = entry->waiting;
+    entry->loading = false;
+    entry->waiting = false;
+    installPage(process, page, *entry, frameNumber);
+    return waiting ? process : nullptr;
+}
 
-            // No suitable contiguous free space found
-            // Attempt to remove oldest process
-            if (!memoryQueue.empty()) {
-                removeOldestProcess();
-            }
-            else {
-                // No processes to remove, allocation fails
-                return false;
+void MemoryManager::installPage(Process* process, unsigned int page, PageTableEntry& entry, int frameNumber) {
+    uint64_t key = ReplacementPolicy::pageKey(process->getId(), page);
+    Frame& frame = frames.at(frameNumber);
+    frame.allocated = true;
+    frame.owner = process;
+    frame.sharers.clear();
+    frame.pageNumber = page;
+    replacementPolicy->onLoad(frameNumber, key);
+
+    entry.frameNumber = frameNumber;
+    entry.present = true;
+    numPagedIn++;
+
+    process->mapPage(page, frameMemory(frameNumber));
+    Tracer::record(TraceEventType::PageIn, process->getId(), page, static_cast<uint32_t>(frameNumber));
+}
+
+void MemoryManager::submitWrites(bool partial) {
+    size_t minimum = partial ? 1 : kWriteBatchPages;
+    SwapIo::Request request;
+    while (backingStore.getNumQueuedWrites() >= minimum && backingStore.takeWriteBatch(request, kWriteBatchPages)) {
+        std::function<void()> release = std::move(request.complete);
+        request.complete = [this, release]() {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            release();
+        };
+        swapIo.submit(std::move(request));
+        request = SwapIo::Request();
+    }
+}
+
+void MemoryManager::storeEvictedPage(int processId, unsigned int page, const uint8_t* data) {
+    // Pages the pool pushes out to make room go to the swap file, shared
+    // by every process that held them
+    bool pooled = swapPool.storePage(processId, page, data, memPerFrame,
+        [this](const std::vector<int>& processIds, uint32_t spilledPage, const uint8_t* spilled, size_t size) {
+            backingStore.storePage(processIds[0], spilledPage, spilled, size);
+            for (size_t i = 1; i < processIds.size(); ++i) {
+                backingStore.sharePage(processIds[0], processIds[i], spilledPage);
             }
+        });
+    if (pooled) {
+        backingStore.releasePage(processId, page);
+    }
+    else {
+        backingStore.storePage(processId, page, data, memPerFrame);
+    }
+}
+
+void MemoryManager::shareEvictedPage(int fromProcessId, int toProcessId, unsigned int page) {
+    if (swapPool.sharePage(fromProcessId, toProcessId, page)) {
+        backingStore.releasePage(toProcessId, page);
+    }
+    else {
+        backingStore.sharePage(fromProcessId, toProcessId, page);
+    }
+}
+
+bool MemoryManager::breakCopyOnWrite(Process* process, unsigned int page, PageTableEntry& entry) {
+    numCowFaults++;
+
+    if (frames.at(entry.frameNumber).sharers.empty()) {
+        // Every other mapping is gone; the page becomes private without a copy
+        process->setPageReadOnly(page, false);
+        return true;
+    }
+
+    // Copy the shared contents out first: finding a frame may evict it
+    const uint8_t* source = frameMemory(entry.frameNumber);
+    std::vector<uint8_t> contents(source, source + memPerFrame);
+
+    uint64_t key = ReplacementPolicy::pageKey(process->getId(), page);
+    int frameNumber = takeFrame(key);
+    if (frameNumber < 0) {
+        return false;
+    }
+    if (entry.present) {
+        process->unmapPage(page);
+        dropMapping(entry.frameNumber, process);
+    }
+
+    uint8_t* data = frameMemory(frameNumber);
+    std::memcpy(data, contents.data(), memPerFrame);
+
+    Frame& frame = frames.at(frameNumber);
+    frame.allocated = true;
+    frame.owner = process;
+    frame.sharers.clear();
+    frame.pageNumber = page;
+    replacementPolicy->onLoad(frameNumber, key);
+
+    entry.frameNumber = frameNumber;
+    entry.present = true;
+
+    // The private copy has never been written out for this process
+    process->mapPage(page, data, false, true);
+    Tracer::record(TraceEventType::CopyOnWrite, process->getId(), page, static_cast<uint32_t>(frameNumber));
+    return true;
+}
+
+void MemoryManager::cloneAddressSpace(Process* parent, Process* child) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    numForks++;
+    backingStore.clonePages(parent->getId(), child->getId());
+    swapPool.clonePages(parent->getId(), child->getId());
+
+    if (flatMemory) {
+        parent->forkInto(*child, false);
+        size_t offset, size;
+        if (flatAllocator->find(parent, offset, size)) {
+            // The resident block is newer than anything in the store
+            backingStore.storePage(child->getId(), 0, frameMemory(0) + offset, size);
+        }
+        return;
+    }
+
+    auto it = pageTables.find(parent);
+    if (it == pageTables.end()) {
+        // The parent is being torn down; the child pages in from the store
+        parent->forkInto(*child, false);
+        admitProcess(child, child->getMemorySize());
+        return;
+    }
+
+    SparseTable<PageTableEntry> table = it->second;
+    table.forEach([this, child](uint64_t, PageTableEntry& entry) {
+        if (entry.present) {
+            frames.at(entry.frameNumber).sharers.push_back(child);
+        }
+        else if (entry.loading) {
+            // The frame being read into is the parent's; the child faults
+            // its own copy in from the store
+            entry = PageTableEntry();
+        }
+    });
+    pageTables[child] = std::move(table);
+    parent->forkInto(*child, true);
+    child->setInMemory(true);
+}
+
+int MemoryManager::takeFrame(uint64_t incomingKey) {
+    int frameNumber = freeFrames.allocate();
+    if (frameNumber >= 0) {
+        return frameNumber;
+    }
+    // An evicted frame passes straight to the caller and stays marked in use
+    return evictPage(incomingKey);
+}
+
+bool MemoryManager::dropMapping(int frameNumber, Process* process) {
+    Frame& frame = frames.at(frameNumber);
+    if (frame.owner == process) {
+        if (frame.sharers.empty()) {
+            frame.allocated = false;
+            frame.owner = nullptr;
+            frame.pageNumber = -1;
+            freeFrames.markFree(frameNumber);
+            replacementPolicy->onRemove(frameNumber);
+            return true;
         }
+        frame.owner = frame.sharers.back();
+        frame.sharers.pop_back();
     }
     else {
-        // Paging allocation remains unchanged
-        unsigned int numPages = (size + memPerFrame - 1) / memPerFrame;
-        std::vector<int> freeFrames;
+        frame.sharers.erase(std::remove(frame.sharers.begin(), frame.sharers.end(), process), frame.sharers.end());
+    }
+    return false;
+}
 
-        while (!findFreeFrames(numPages, freeFrames)) {
-            if (!memoryQueue.empty()) {
-                removeOldestProcess();
+int MemoryManager::evictPage(uint64_t incomingKey) {
+    // The policy forgets the victim as it picks it
+    int frameNumber = replacementPolicy->chooseVictim(incomingKey);
+    if (frameNumber < 0) {
+        return -1;
+    }
+    Frame& frame = frames.at(frameNumber);
+
+    // Only pages written while resident need to go back to the store.
+    // A frame shared by forks is written out once and the stored copy
+    // shared by every other process that dirtied it.
+    frame.sharers.push_back(frame.owner);
+    int storedBy = -1;
+    for (Process* mapper : frame.sharers) {
+        Tracer::record(TraceEventType::Evict, mapper->getId(), frame.pageNumber, static_cast<uint32_t>(frameNumber));
+        if (mapper->unmapPage(frame.pageNumber)) {
+            Tracer::record(TraceEventType::PageOut, mapper->getId(), frame.pageNumber, static_cast<uint32_t>(frameNumber));
+            if (storedBy < 0) {
+                storedBy = mapper->getId();
+                storeEvictedPage(storedBy, frame.pageNumber, frameMemory(frameNumber));
             }
             else {
-                // No processes to remove, allocation fails
-                return false;
+                shareEvictedPage(storedBy, mapper->getId(), frame.pageNumber);
             }
         }
-
-        // Allocate frames
-        std::vector<PageTableEntry> pageTable(numPages);
-        for (size_t i = 0; i < numPages; ++i) {
-            int frameNum = freeFrames[i];
-            frames[frameNum].allocated = true;
-            frames[frameNum].owner = process;
-            frames[frameNum].pageNumber = i;
-
-            pageTable[i].frameNumber = frameNum;
-            pageTable[i].present = true;
-            numPagedIn++;
+        PageTableEntry* entry = pageTables[mapper].find(frame.pageNumber);
+        if (entry != nullptr) {
+            *entry = PageTableEntry();
         }
 
-        pageTables[process] = std::move(pageTable);
-        memoryQueue.push_back(process);
-
-        process->setInMemory(true);
-        if (swappedOutProcesses.erase(process) > 0) {
-            // Process was in the backing store, so clear the content of the .txt file
-            int processId = process->getId();
-            std::string filename = std::to_string(processId) + ".txt";
-            std::ofstream outfile(filename, std::ios::trunc);
-            if (!outfile.is_open()) {
-                std::cerr << "Failed to open backing store file for process " << processId << " to empty it" << std::endl;
-            }
-            outfile.close();
+        std::deque<unsigned int>& evicted = evictedPages[mapper];
+        evicted.push_back(frame.pageNumber);
+        if (evicted.size() > kReadAheadPages) {
+            evicted.pop_front();
         }
+    }
+    submitWrites(false);
+
+    frame.allocated = false;
+    frame.owner = nullptr;
+    frame.sharers.clear();
+    frame.pageNumber = -1;
+    numPagedOut++;
+    return frameNumber;
+}
 
-        return true;
+uint8_t* MemoryManager::frameMemory(int frameNumber) {
+    auto& data = frames.at(frameNumber).data;
+    if (!data) {
+        data.reset(new uint8_t[memPerFrame]);
     }
+    return data.get();
 }
 
 void MemoryManager::deallocateMemory(Process* process) {
     std::lock_guard<std::mutex> lock(memoryMutex);
 
     if (flatMemory) {
-        bool found = false;
-
-        for (size_t i = 0; i < memoryBlocks.size(); ++i) {
-            if (memoryBlocks[i].process == process) {
-                usedMemory -= memoryBlocks[i].size;
-                memoryBlocks[i].process = nullptr;
-                found = true;
-                break;  // Assuming process occupies a single block
-            }
-        }
-
-        if (found) {
-            // Merge adjacent free blocks
-            mergeAdjacentFreeBlocks();
+        size_t offset, size;
+        if (flatAllocator->release(process, offset, size)) {
+            process->unmapPage(0);
         }
     }
     else {
-        // Paging deallocation remains unchanged
         auto it = pageTables.find(process);
         if (it != pageTables.end()) {
-            for (const auto& entry : it->second) {
+            it->second.forEach([this, process](uint64_t page, const PageTableEntry& entry) {
                 if (entry.present) {
-                    frames[entry.frameNumber].allocated = false;
-                    frames[entry.frameNumber].owner = nullptr;
-                    frames[entry.frameNumber].pageNumber = -1;
-                    numPagedOut++;
+                    process->unmapPage(static_cast<unsigned int>(page));
+                    if (dropMapping(entry.frameNumber, process)) {
+                        numPagedOut++;
+                    }
                 }
-            }
+            });
             pageTables.erase(it);
         }
     }
 
-    memoryQueue.remove(process);
+    auto queuePosition = memoryQueuePositions.find(process);
+    if (queuePosition != memoryQueuePositions.end()) {
+        memoryQueue.erase(queuePosition->second);
+        memoryQueuePositions.erase(queuePosition);
+    }
     swappedOutProcesses.erase(process);
+    evictedPages.erase(process);
+    backingStore.releaseProcess(process->getId());
+    swapPool.releaseProcess(process->getId());
     process->setInMemory(false);
 }
 
@@ -313,16 +614,10 @@ unsigned int MemoryManager::getUsedMemory() const {
     std::lock_guard<std::mutex> lock(memoryMutex);
 
     if (flatMemory) {
-        return usedMemory;
+        return static_cast<unsigned int>(flatAllocator->getUsed());
     }
     else {
-        unsigned int usedFrames = 0;
-        for (const auto& frame : frames) {
-            if (frame.allocated) {
-                usedFrames++;
-            }
-        }
-        return usedFrames * memPerFrame;
+        return static_cast<unsigned int>(freeFrames.getNumUsed()) * memPerFrame;
     }
 }
 
@@ -343,19 +638,17 @@ std::vector<std::pair<Process*, unsigned int>> MemoryManager::getProcessesInMemo
     std::vector<std::pair<Process*, unsigned int>> result;
 
     if (flatMemory) {
-        for (const auto& block : memoryBlocks) {
-            if (block.process != nullptr) {
-                result.emplace_back(block.process, block.size);
-            }
-        }
+        flatAllocator->forEachAllocation([&result](Process* owner, size_t, size_t size) {
+            result.emplace_back(owner, static_cast<unsigned int>(size));
+        });
     }
     else {
+        // Resident sizes are kept by the processes as pages are mapped
         for (const auto& pair : pageTables) {
-            unsigned int numPages = 0;
-            for (const auto& entry : pair.second) {
-                if (entry.present) numPages++;
+            unsigned int resident = pair.first->getResidentMemory();
+            if (resident > 0) {
+                result.emplace_back(pair.first, resident);
             }
-            result.emplace_back(pair.first, numPages * memPerFrame);
         }
     }
 
@@ -391,14 +684,175 @@ unsigned int MemoryManager::getNumPagedOut() const {
     return numPagedOut;
 }
 
+unsigned int MemoryManager::getNumPageFaults() const {
+    return numPageFaults;
+}
+
+unsigned int MemoryManager::getNumBackingStoreReads() const {
+    return backingStore.getNumReads();
+}
+
+unsigned int MemoryManager::getNumBackingStoreWrites() const {
+    return backingStore.getNumWrites();
+}
+
+unsigned int MemoryManager::getSwapUsed() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return static_cast<unsigned int>(backingStore.getNumUsedSlots() * backingStore.getSlotSize());
+}
+
+unsigned int MemoryManager::getSwapSize() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return static_cast<unsigned int>(backingStore.getSwapSize());
+}
+
+unsigned int MemoryManager::getNumBlockedFaults() const {
+    return numBlockedFaults;
+}
+
+unsigned int MemoryManager::getNumReadAheadPages() const {
+    return numReadAheadPages;
+}
+
+unsigned int MemoryManager::getNumWriteBatches() const {
+    return backingStore.getNumWriteBatches();
+}
+
+bool MemoryManager::isSwapPoolEnabled() const {
+    return swapPool.isEnabled();
+}
+
+unsigned int MemoryManager::getSwapPoolUsed() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return static_cast<unsigned int>(swapPool.getUsedBytes());
+}
+
+double MemoryManager::getSwapPoolRatio() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    size_t used = swapPool.getUsedBytes();
+    return used > 0 ? static_cast<double>(swapPool.getStoredBytes()) / used : 0.0;
+}
+
+double MemoryManager::getSwapPoolHitRatio() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    unsigned int swapIns = swapPool.getNumHits() + backingStore.getNumReads();
+    return swapIns > 0 ? 100.0 * swapPool.getNumHits() / swapIns : 0.0;
+}
+
+unsigned int MemoryManager::getNumCowFaults() const {
+    return numCowFaults;
+}
+
+unsigned int MemoryManager::getNumForks() const {
+    return numForks;
+}
+
+unsigned int MemoryManager::getNumSharedFrames() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    unsigned int shared = 0;
+    frames.forEach([&shared](uint64_t, const Frame& frame) {
+        if (frame.allocated && !frame.sharers.empty()) {
+            shared++;
+        }
+    });
+    return shared;
+}
+
+std::string MemoryManager::getAllocatorName() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return flatAllocator ? flatAllocator->getName() : "";
+}
+
+unsigned int MemoryManager::getInternalFragmentation() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    if (!flatAllocator) {
+        return 0;
+    }
+    return static_cast<unsigned int>(flatAllocator->getUsed() - flatAllocator->getRequested());
+}
+
+unsigned int MemoryManager::getNumFreeBlocks() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return flatAllocator ? static_cast<unsigned int>(flatAllocator->getNumFreeBlocks()) : 0;
+}
+
+unsigned int MemoryManager::getLargestFreeBlock() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return flatAllocator ? static_cast<unsigned int>(flatAllocator->getLargestFreeBlock()) : 0;
+}
+
+unsigned long long MemoryManager::getAverageAllocationNanos() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return numFlatAllocations > 0 ? flatAllocationNanos / numFlatAllocations : 0;
+}
+
+unsigned int MemoryManager::getNumCompactionMoves() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return numCompactionMoves;
+}
+
+unsigned long long MemoryManager::getBytesCompacted() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return bytesCompacted;
+}
+
+std::string MemoryManager::getReplacementPolicyName() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    return replacementPolicy ? replacementPolicy->getName() : "";
+}
+
+double MemoryManager::getPageHitRatio() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    unsigned long long references = numResidentAccesses + numPagedIn;
+    return references > 0 ? 100.0 * numResidentAccesses / references : 0.0;
+}
+
+double MemoryManager::getPageFaultRate() const {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    unsigned long long references = numResidentAccesses + numPagedIn;
+    return references > 0 ? 1000.0 * numPagedIn / references : 0.0;
+}
+
 void MemoryManager::incrementIdleCpuTicks() {
     std::lock_guard<std::mutex> lock(memoryMutex);
     idleCpuTicks++;
     totalCpuTicks++;
+
+    // Idle cores compact flat memory a little at a time, so allocations
+    // rarely have to wait for it
+    compactMemory(kIdleCompactionBlocks);
+    if (totalCpuTicks % kWriteBehindTicks == 0) {
+        submitWrites(true);
+    }
+    if (totalCpuTicks % kSwapTrimTicks == 0) {
+        backingStore.trim();
+    }
 }
 
-void MemoryManager::incrementActiveCpuTicks() {
+void MemoryManager::incrementActiveCpuTicks(Process* process) {
     std::lock_guard<std::mutex> lock(memoryMutex);
     activeCpuTicks++;
     totalCpuTicks++;
+    if (totalCpuTicks % kWriteBehindTicks == 0) {
+        submitWrites(true);
+    }
+    if (totalCpuTicks % kSwapTrimTicks == 0) {
+        backingStore.trim();
+    }
+
+    if (process == nullptr || flatMemory) {
+        return;
+    }
+    auto it = pageTables.find(process);
+    if (it == pageTables.end()) {
+        return;
+    }
+    referencedPages.clear();
+    numResidentAccesses += process->takeReferences(referencedPages);
+    for (unsigned int page : referencedPages) {
+        const PageTableEntry* entry = it->second.find(page);
+        if (entry != nullptr && entry->present) {
+            replacementPolicy->onAccess(entry->frameNumber);
+        }
+    }
 }
\ No newline at end of file
@@ -5,23 +5,43 @@
 #include <mutex>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include "BackingStore.h"
+#include "BuddyAllocator.h"
+#include "CompressedPool.h"
+#include "FlatAllocator.h"
+#include "FrameBitmap.h"
 #include "Process.h"
-
-struct MemoryBlock {
-    size_t offset;
-    size_t size;
-    Process* process;
-};
+#include "ReplacementPolicy.h"
+#include "SparseTable.h"
+#include "SwapIo.h"
 
 struct Frame {
-    bool allocated;
-    Process* owner;
-    int pageNumber;
+    bool allocated = false;
+    Process* owner = nullptr;
+    std::vector<Process*> sharers;  // forks mapping the same page copy-on-write
+    int pageNumber = -1;
+
+    // Host memory behind the frame, allocated on first use. In flat mode
+    // the single frame spans all of memory.
+    std::unique_ptr<uint8_t[]> data;
 };
 
 struct PageTableEntry {
-    int frameNumber;
-    bool present;
+    int frameNumber = -1;
+    bool present = false;
+    bool loading = false;   // a swap read into frameNumber is in flight
+    bool waiting = false;   // the process is blocked until that read completes
+};
+
+enum class FaultResult {
+    Resolved,   // the page is resident; retry the instruction
+    Blocked,    // a swap read was queued; the process is requeued when it completes
+    Failed      // no frame could be found
 };
 
 class MemoryManager {
@@ -29,10 +49,44 @@ public:
     MemoryManager();
     ~MemoryManager();
 
-    void initialize(unsigned int maxMem, unsigned int memPerFrame);
+    // A nonzero swapPoolSize puts a compressed pool of that many bytes in
+    // front of the swap file when paging
+    void initialize(unsigned int maxMem, unsigned int memPerFrame, FitPolicy fitPolicy = FitPolicy::First,
+        bool buddy = false, const std::string& replacementPolicy = "fifo", unsigned int swapPoolSize = 0);
     bool allocateMemory(Process* process, unsigned int size);
+
+    // Admits each process with its own memory size under a single lock
+    // acquisition. In flat mode nothing is swapped out to make room;
+    // processes that do not fit stay non-resident until they are
+    // scheduled. Returns the processes that can never be admitted.
+    std::vector<Process*> allocateMemoryBatch(const std::vector<Process*>& processes);
     void deallocateMemory(Process* process);
 
+    // Makes the page containing address resident after the process faulted
+    // on it. A page that has to come from the swap file is read on the
+    // swap I/O threads; the faulting process is then Blocked, and must be
+    // left off the ready queue until the page-in handler hands it back.
+    FaultResult handlePageFault(Process* process, uint32_t address);
+
+    // Called, without the memory lock, for each process whose blocking
+    // page-in has completed
+    void setPageInHandler(std::function<void(Process*)> handler);
+
+    // Starts reading back, into free frames only, the pages the process
+    // most recently lost to eviction. Used as it nears the head of the
+    // ready queue.
+    void prefetch(Process* process);
+
+    // Blocks until all swap I/O submitted so far has completed
+    void waitForSwapIo();
+
+    // Gives a freshly constructed child a copy of the parent's address
+    // space and execution state. With paging, resident frames are shared
+    // read-only and copied on the first write by either process; flat
+    // mode has a single block per process, so the child gets its own
+    // copy in the backing store and is loaded when first scheduled.
+    void cloneAddressSpace(Process* parent, Process* child);
+
     unsigned int getTotalMemory() const;
     unsigned int getUsedMemory() const;
     unsigned int getFreeMemory() const;
@@ -43,20 +97,91 @@ public:
     unsigned int getTotalCpuTicks() const;
     unsigned int getNumPagedIn() const;
     unsigned int getNumPagedOut() const;
+    unsigned int getNumPageFaults() const;
+    unsigned int getNumBackingStoreReads() const;
+    unsigned int getNumBackingStoreWrites() const;
+    unsigned int getSwapUsed() const;       // bytes in swap slots holding pages
+    unsigned int getSwapSize() const;       // bytes the swap file spans
+    unsigned int getNumBlockedFaults() const;       // faults that waited on a swap read
+    unsigned int getNumReadAheadPages() const;
+    unsigned int getNumWriteBatches() const;
+
+    // Compressed swap pool statistics
+    bool isSwapPoolEnabled() const;
+    unsigned int getSwapPoolUsed() const;   // compressed bytes held
+    double getSwapPoolRatio() const;        // uncompressed bytes per compressed byte
+    double getSwapPoolHitRatio() const;     // percent of page-ins from swap served by the pool
+    unsigned int getNumCowFaults() const;
+    unsigned int getNumForks() const;
+    unsigned int getNumSharedFrames() const;
+
+    // Flat-mode allocator statistics
+    std::string getAllocatorName() const;
+    unsigned int getInternalFragmentation() const;     // bytes lost to rounding blocks up
+    unsigned int getNumFreeBlocks() const;
+    unsigned int getLargestFreeBlock() const;
+    unsigned long long getAverageAllocationNanos() const;
+    unsigned int getNumCompactionMoves() const;
+    unsigned long long getBytesCompacted() const;
+
+    // Paging replacement statistics. References are collected once per
+    // active tick, so they lag execution by at most one instruction.
+    std::string getReplacementPolicyName() const;
+    double getPageHitRatio() const;         // percent of references that found their page resident
+    double getPageFaultRate() const;        // page-ins per 1000 references
 
     void incrementIdleCpuTicks();
-    void incrementActiveCpuTicks();
+    // With a process, also passes the pages it referenced during the tick
+    // to the replacement policy
+    void incrementActiveCpuTicks(Process* process = nullptr);
 
     std::vector<std::pair<Process*, unsigned int>> getProcessesInMemory() const;
     bool isProcessInMemory(Process* process) const;
     bool isPaging() const;
 
 private:
-    // void compactMemory();
-    void mergeAdjacentFreeBlocks();
-    bool findFreeFrames(unsigned int numFramesNeeded, std::vector<int>& frameNumbers);
+    // Blocks slid down per idle CPU tick, and per retry when an allocation
+    // fails for want of a contiguous block
+    static constexpr unsigned int kIdleCompactionBlocks = 1;
+    static constexpr unsigned int kDemandCompactionBlocks = 8;
+
+    // The swap file, in the working directory, and how often its unused
+    // tail is given back
+    static constexpr const char* kSwapFile = "osemu.swap";
+    static constexpr unsigned int kSwapTrimTicks = 4096;
+
+    // Swap I/O threads; buffered writes per batch, and the ticks after
+    // which a partial batch goes out anyway; evicted pages remembered per
+    // process for read-ahead
+    static constexpr unsigned int kSwapIoThreads = 2;
+    static constexpr size_t kWriteBatchPages = 8;
+    static constexpr unsigned int kWriteBehindTicks = 16;
+    static constexpr size_t kReadAheadPages = 4;
+
+    // Moves up to maxBlocks flat-memory blocks towards address zero,
+    // merging free space into one block at the top. Returns false once
+    // nothing is left to move.
+    bool compactMemory(unsigned int maxBlocks);
     void removeOldestProcess();
 
+    bool admitProcess(Process* process, unsigned int size);
+    bool allocateFlatMemory(Process* process, unsigned int size, bool allowEviction = true);
+    void assignFlatBlock(Process* process, size_t offset, size_t size);
+    uint8_t* frameMemory(int frameNumber);
+    void installPage(Process* process, unsigned int page, PageTableEntry& entry, int frameNumber);
+    bool startPageIn(Process* process, unsigned int page, PageTableEntry& entry, int frameNumber, bool wake);
+    Process* finishPageIn(Process* process, unsigned int page, int frameNumber);
+    void submitWrites(bool partial);    // with partial, a short last batch goes out too
+
+    // Write an evicted page to the compressed pool, or to the swap file if
+    // the pool turns it away
+    void storeEvictedPage(int processId, unsigned int page, const uint8_t* data);
+    void shareEvictedPage(int fromProcessId, int toProcessId, unsigned int page);
+    int evictPage(uint64_t incomingKey);
+    int takeFrame(uint64_t incomingKey);
+    bool breakCopyOnWrite(Process* process, unsigned int page, PageTableEntry& entry);
+    bool dropMapping(int frameNumber, Process* process);
+
     mutable std::mutex memoryMutex;
     unsigned int maxMemory;
     unsigned int memPerFrame;
@@ -64,19 +189,46 @@ private:
     bool flatMemory;
 
     // For flat memory allocation
-    std::vector<MemoryBlock> memoryBlocks;
-    unsigned int usedMemory;
-
-    // For paging allocation
-    std::vector<Frame> frames;
-    std::map<Process*, std::vector<PageTableEntry>> pageTables;
-
+    std::unique_ptr<BlockAllocator> flatAllocator;
+    unsigned long long numFlatAllocations;
+    unsigned long long flatAllocationNanos;
+    unsigned int numCompactionMoves;
+    unsigned long long bytesCompacted;
+
+    // For paging allocation. Frame records and page table entries live in
+    // radix tables, so host memory follows the frames and pages actually
+    // touched rather than the configured sizes.
+    SparseTable<Frame> frames;
+    FrameBitmap freeFrames;
+    std::unordered_map<Process*, SparseTable<PageTableEntry>> pageTables;
+    std::unique_ptr<ReplacementPolicy> replacementPolicy;
+    std::vector<unsigned int> referencedPages;     // scratch for collecting references
+    unsigned long long numResidentAccesses;
+
+    BackingStore backingStore;
+    CompressedPool swapPool;
+    std::function<void(Process*)> pageInHandler;
+
+    // Pages each process most recently lost to eviction, oldest first,
+    // for read-ahead
+    std::unordered_map<Process*, std::deque<unsigned int>> evictedPages;
+    unsigned int numBlockedFaults;
+    unsigned int numReadAheadPages;
+
+    // Flat-mode residents, oldest first, with each one's position for O(1) removal
     std::list<Process*> memoryQueue;
+    std::unordered_map<Process*, std::list<Process*>::iterator> memoryQueuePositions;
     std::set<Process*> swappedOutProcesses;
 
     unsigned int numPagedIn;
     unsigned int numPagedOut;
+    unsigned int numPageFaults;
+    unsigned int numCowFaults;
+    unsigned int numForks;
     unsigned int idleCpuTicks;
     unsigned int activeCpuTicks;
     unsigned int totalCpuTicks;
+
+    // Last, so it drains before anything its completions touch is destroyed
+    SwapIo swapIo;
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "PidAllocator.h"
+#include "BitOps.h"
+
+constexpr int PidAllocator::kMaxPid;
+constexpr int PidAllocator::kRecycleGraceSeconds;
+constexpr int PidAllocator::kNumLeaves;
+constexpr int PidAllocator::kNumSummaries;
+constexpr int PidAllocator::kNumRoots;
+constexpr int PidAllocator::kNumLevels;
+
+PidAllocator::PidAllocator()
+    : nextPid(1), numAllocated(0) {
+    levels[0].assign(kNumLeaves, 0);
+    levels[1].assign(kNumSummaries, 0);
+    levels[2].assign(kNumRoots, 0);
+
+    // PID 0 is never issued
+    for (int leaf = 0; leaf < kNumLeaves; ++leaf) {
+        int first = leaf * 64;
+        uint64_t bits = ~uint64_t(0);
+        if (first == 0) {
+            bits &= ~uint64_t(1);
+        }
+        if (first + 63 > kMaxPid) {
+            bits &= ~BitOps::maskFrom(kMaxPid - first + 1);
+        }
+        levels[0][leaf] = bits;
+    }
+    for (int level = 1; level < kNumLevels; ++level) {
+        const std::vector<uint64_t>& below = levels[level - 1];
+        for (size_t i = 0; i < below.size(); ++i) {
+            if (below[i] != 0) {
+                levels[level][i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+}
+
+int PidAllocator::allocate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    recycleExpired(Clock::now());
+    return allocateLocked();
+}
+
+size_t PidAllocator::allocateBatch(size_t count, std::vector<int>& pids) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recycleExpired(Clock::now());
+
+    size_t issued = 0;
+    for (; issued < count; ++issued) {
+        int pid = allocateLocked();
+        if (pid < 0) break;
+        pids.push_back(pid);
+    }
+    return issued;
+}
+
+void PidAllocator::release(int pid) {
+    if (pid < 1 || pid > kMaxPid) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    quarantine.emplace_back(pid, Clock::now());
+    numAllocated--;
+}
+
+int PidAllocator::getNumAllocated() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numAllocated;
+}
+
+int PidAllocator::allocateLocked() {
+    // Hand out IDs in increasing order and wrap, like a conventional
+    // PID counter, so a released ID is not reused right away
+    int pid = findFrom(0, nextPid);
+    if (pid < 0) {
+        pid = findFrom(0, 1);
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    markUsed(pid);
+    numAllocated++;
+    nextPid = pid < kMaxPid ? pid + 1 : 1;
+    return pid;
+}
+
+void PidAllocator::markFree(int pid) {
+    int index = pid;
+    for (int level = 0; level < kNumLevels; ++level) {
+        uint64_t& word = levels[level][index / 64];
+        bool wasEmpty = word == 0;
+        word |= uint64_t(1) << (index % 64);
+        if (!wasEmpty) break;
+        index /= 64;
+    }
+}
+
+void PidAllocator::markUsed(int pid) {
+    int index = pid;
+    for (int level = 0; level < kNumLevels; ++level) {
+        uint64_t& word = levels[level][index / 64];
+        word &= ~(uint64_t(1) << (index % 64));
+        if (word != 0) break;
+        index /= 64;
+    }
+}
+
+// First set bit at or after index on the given level, or -1. A miss in
+// the current word moves up a level to find the next non-empty word.
+int PidAllocator::findFrom(int level, int index) const {
+    const std::vector<uint64_t>& words = levels[level];
+    int word = index / 64;
+    if (word >= static_cast<int>(words.size())) {
+        return -1;
+    }
+
+    uint64_t bits = words[word] & BitOps::maskFrom(index % 64);
+    if (bits != 0) {
+        return word * 64 + static_cast<int>(BitOps::countTrailingZeros(bits));
+    }
+
+    int next;
+    if (level + 1 < kNumLevels) {
+        next = findFrom(level + 1, word + 1);
+    }
+    else {
+        next = -1;
+        for (int i = word + 1; i < static_cast<int>(words.size()); ++i) {
+            if (words[i] != 0) {
+                next = i;
+                break;
+            }
+        }
+    }
+    if (next < 0) {
+        return -1;
+    }
+    return next * 64 + static_cast<int>(BitOps::countTrailingZeros(words[next]));
+}
+
+void PidAllocator::recycleExpired(Clock::time_point now) {
+    const auto grace = std::chrono::seconds(kRecycleGraceSeconds);
+    while (!quarantine.empty() && now - quarantine.front().second >= grace) {
+        markFree(quarantine.front().first);
+        quarantine.pop_front();
+    }
+}
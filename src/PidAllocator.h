@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Issues process IDs from a bounded space using a hierarchical bitmap:
+// each leaf word tracks 64 PIDs, a summary bit per leaf marks words that
+// still have a free PID, and a root bit per summary word does the same one
+// level up, so a scan touches at most a few words per level.
+// Released PIDs are quarantined for a grace period before reuse, so a
+// stale PID seen by a monitor or in a log cannot name a new process.
+class PidAllocator {
+public:
+    static constexpr int kMaxPid = 1 << 22;         // IDs are 1..kMaxPid
+    static constexpr int kRecycleGraceSeconds = 5;
+
+    PidAllocator();
+
+    // Returns a free PID, or -1 if the space is exhausted
+    int allocate();
+
+    // Appends up to count PIDs to pids under one lock acquisition.
+    // Returns how many were issued.
+    size_t allocateBatch(size_t count, std::vector<int>& pids);
+    void release(int pid);
+
+    int getNumAllocated() const;
+
+private:
+    static constexpr int kNumLeaves = kMaxPid / 64 + 1;
+    static constexpr int kNumSummaries = (kNumLeaves + 63) / 64;
+    static constexpr int kNumRoots = (kNumSummaries + 63) / 64;
+    static constexpr int kNumLevels = 3;
+
+    using Clock = std::chrono::steady_clock;
+
+    int allocateLocked();
+    void markFree(int pid);
+    void markUsed(int pid);
+    int findFrom(int level, int index) const;
+    void recycleExpired(Clock::time_point now);
+
+    // levels[0] holds one bit per PID, levels[1] one bit per leaf word and
+    // levels[2] one bit per summary word. A set bit means free below.
+    std::vector<uint64_t> levels[kNumLevels];
+    int nextPid;                            // where the next scan starts
+    int numAllocated;
+    std::deque<std::pair<int, Clock::time_point>> quarantine;
+    mutable std::mutex mutex;
+};
@@ -1,39 +1,38 @@
 #include "Process.h"
-#include "Command.h"
-#include <fstream>
-#include <iostream>
+#include "LogWriter.h"
+#include "ProcessRanking.h"
+#include "Tlb.h"
+#include <cstring>
 #include <ctime>
-#include <iomanip>
 #include <mutex>
 
-int Process::nextId = 1;
-bool Process::loggingEnabled = false;
+constexpr const char* Process::kNamePlaceholder;
 
-Process::Process(const std::string& name)
-    : name(name), currentLine(0), totalLines(0), completed(false),
-      memorySize(0), inMemory(false) {
+std::atomic<bool> Process::loggingEnabled(false);
+
+Process::Process(const std::string& name, int id)
+    : name(name), id(id), memorySize(0), pageSize(0),
+      violationAddress(0), violationTime(0),
+      currentLine(0), totalLines(0), completed(false), inMemory(false), residentMemory(0), accessViolation(false),
+      finishTime(0), attached(false), ranking(nullptr), rankedProgress(0), logSequence(0) {
     creationTime = std::chrono::system_clock::now();
-    id = nextId++;
+    context.process = this;
+
+    // A recycled PID must not inherit the translations of its last owner
+    Tlb::flushAsid(static_cast<uint32_t>(id));
 
     if (loggingEnabled) {
         // Initialize process log file only if logging is enabled
-        std::ofstream logfile(name + ".txt", std::ios::out);
-        if (logfile.is_open()) {
-            logfile << "Process name: " << name << "\nLogs:\n";
-            logfile.close();
-        }
-        else {
-            std::cerr << "Unable to create log file for process " << name << std::endl;
-        }
+        LogRecord record;
+        record.processName = name;
+        record.processId = id;
+        record.sequence = logSequence.fetch_add(1, std::memory_order_relaxed);
+        record.header = true;
+        LogWriter::getInstance().append(-1, std::move(record));
     }
 }
 
-Process::~Process() {
-    while (!commandQueue.empty()) {
-        delete commandQueue.front();
-        commandQueue.pop();
-    }
-}
+Process::~Process() {}
 
 int Process::getId() const {
     return id;
@@ -52,58 +51,310 @@ unsigned int Process::getMemorySize() const {
 }
 
 void Process::setInMemory(bool inMemory) {
-    this->inMemory = inMemory;
+    this->inMemory.store(inMemory, std::memory_order_release);
 }
 
 bool Process::isInMemory() const {
-    return inMemory;
+    return inMemory.load(std::memory_order_acquire);
 }
 
-void Process::addCommand(Command* cmd) {
+void Process::loadProgram(std::shared_ptr<Program> program) {
     {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        commandQueue.push(cmd);
+        std::lock_guard<std::mutex> lock(programMutex);
+        this->program = std::move(program);
+        context = ExecutionContext();
+        context.process = this;
+        context.program = this->program.get();
+        attachAddressSpace();
     }
 
-    // Store command description for display
+    currentLine.store(0, std::memory_order_relaxed);
+    totalLines.store(context.program ? static_cast<int>(context.program->getDynamicLength()) : 0,
+        std::memory_order_relaxed);
+    updateRanking();
+}
+
+void Process::appendPrint(const std::string& message) {
     {
-        std::lock_guard<std::mutex> lock(stateMutex);
-        totalLines++;
-        codeLines.push_back(cmd->getDescription());
+        std::lock_guard<std::mutex> lock(programMutex);
+        if (!program) {
+            program = std::make_shared<Program>();
+        }
+        else if (program.use_count() > 1) {
+            // Programs can be shared between processes; copy before changing it
+            program = std::make_shared<Program>(*program);
+        }
+        context.program = program.get();
+        program->appendPrint(message);
     }
+
+    totalLines.fetch_add(1, std::memory_order_relaxed);
+    updateRanking();
 }
 
-Command* Process::getNextCommand() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    if (commandQueue.empty()) {
-        return nullptr;
+Interpreter::StepResult Process::executeNextInstruction(int coreId) {
+    Interpreter::StepResult result;
+    {
+        std::lock_guard<std::mutex> lock(programMutex);
+        if (context.program == nullptr) {
+            return Interpreter::StepResult::Finished;
+        }
+        context.coreId = coreId;
+        context.tlb = Tlb::forCore(coreId);
+        context.asid = static_cast<uint32_t>(id);
+        result = Interpreter::step(context);
+
+        if (result == Interpreter::StepResult::AccessViolation) {
+            violationAddress = context.faultAddress;
+            violationTime = std::time(nullptr);
+            accessViolation.store(true, std::memory_order_release);
+        }
     }
-    Command* cmd = commandQueue.front();
-    commandQueue.pop();
-    return cmd;
+
+    if (result == Interpreter::StepResult::Executed || result == Interpreter::StepResult::Forked) {
+        // This core is the only writer
+        int line = currentLine.load(std::memory_order_relaxed) + 1;
+        currentLine.store(line, std::memory_order_relaxed);
+
+        // The ranking only needs to hear about a new progress bucket
+        uint32_t bucket = ProcessRanking::progressBucket(line, totalLines.load(std::memory_order_relaxed));
+        if (bucket != rankedProgress) {
+            rankedProgress = bucket;
+            updateRanking();
+        }
+    }
+    return result;
+}
+
+bool Process::hasRemainingInstructions() const {
+    std::lock_guard<std::mutex> lock(programMutex);
+    return Interpreter::hasRemainingWork(context);
 }
 
 void Process::log(const std::string& message, int coreId) {
     if (!loggingEnabled) return;
 
-    std::lock_guard<std::mutex> lock(logMutex);
-    // Open the process's log file and append the message
-    std::ofstream logfile(name + ".txt", std::ios::app);
+    // Handed to the background writer; the core never waits on the file
+    LogRecord record;
+    record.processName = name;
+    record.message = message;
+    record.processId = id;
+    record.sequence = logSequence.fetch_add(1, std::memory_order_relaxed);
+    record.instructionIndex = static_cast<uint32_t>(getCurrentLine());
+    LogWriter::getInstance().append(coreId, std::move(record));
+}
 
-    if (logfile.is_open()) {
-        // Get current time
-        std::time_t now = std::time(nullptr);
-        std::tm now_tm;
+void Process::log(const std::string& message, uint16_t value, int coreId) {
+    if (!loggingEnabled) return;
 
-        localtime_s(&now_tm, &now);
+    // The value is formatted by the writer, off the core's time slice
+    LogRecord record;
+    record.processName = name;
+    record.message = message;
+    record.processId = id;
+    record.sequence = logSequence.fetch_add(1, std::memory_order_relaxed);
+    record.instructionIndex = static_cast<uint32_t>(getCurrentLine());
+    record.argument = value;
+    record.hasArgument = true;
+    LogWriter::getInstance().append(coreId, std::move(record));
+}
 
-        logfile << "(" << std::put_time(&now_tm, "%m/%d/%Y %I:%M:%S%p") << ") ";
-        logfile << "Core:" << coreId << " \"" << message << "\"\n";
-        logfile.close();
+void Process::appendExpanded(std::string& out, const std::string& message, const std::string& name) {
+    static const size_t placeholderLength = std::strlen(kNamePlaceholder);
+    size_t from = 0;
+    for (size_t at = message.find(kNamePlaceholder); at != std::string::npos;
+        at = message.find(kNamePlaceholder, from)) {
+        out.append(message, from, at - from);
+        out += name;
+        from = at + placeholderLength;
+    }
+    out.append(message, from, std::string::npos);
+}
+
+void Process::initAddressSpace(unsigned int pageSize) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    if (this->pageSize == pageSize) {
+        return;
+    }
+
+    this->pageSize = pageSize;
+    unsigned int numPages = (memorySize + pageSize - 1) / pageSize;
+    pageTable = SparseTable<PageSlot>(numPages);
+    residentMemory.store(0, std::memory_order_relaxed);
+    updateRanking();
+    Tlb::flushAsid(static_cast<uint32_t>(id));
+    attachAddressSpace();
+}
+
+void Process::attachAddressSpace() {
+    if (pageSize == 0) {
+        Interpreter::attachMemory(context, nullptr, 0, 0);
+        return;
+    }
+    uint32_t pageShift = 0;
+    while ((1u << pageShift) < pageSize) {
+        pageShift++;
+    }
+    Interpreter::attachMemory(context, &pageTable, pageShift, memorySize);
+}
+
+unsigned int Process::getPageSize() const {
+    std::lock_guard<std::mutex> lock(programMutex);
+    return pageSize;
+}
+
+unsigned int Process::getNumPages() const {
+    std::lock_guard<std::mutex> lock(programMutex);
+    return static_cast<unsigned int>(pageTable.size());
+}
+
+void Process::mapPage(unsigned int page, uint8_t* frame, bool readOnly, bool dirty) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    PageSlot& slot = pageTable.at(page);
+    if (slot.base == nullptr) {
+        residentMemory.store(residentMemory.load(std::memory_order_relaxed) + pageSize, std::memory_order_relaxed);
+        updateRanking();
     }
     else {
-        std::cerr << "Unable to open log file for process " << name << std::endl;
+        Tlb::shootdown(static_cast<uint32_t>(id), page);
     }
+    slot.base = frame;
+    slot.flags = (readOnly ? PageFlags::ReadOnly : 0) | (dirty ? PageFlags::Dirty : 0);
+}
+
+bool Process::unmapPage(unsigned int page) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    PageSlot* slot = pageTable.find(page);
+    if (slot == nullptr) {
+        return false;
+    }
+    bool dirty = (slot->flags & PageFlags::Dirty) != 0;
+    if (slot->base != nullptr) {
+        residentMemory.store(residentMemory.load(std::memory_order_relaxed) - pageSize, std::memory_order_relaxed);
+        updateRanking();
+        Tlb::shootdown(static_cast<uint32_t>(id), page);
+    }
+    slot->base = nullptr;
+    slot->flags = 0;
+    return dirty;
+}
+
+void Process::movePage(unsigned int page, uint8_t* frame, size_t size) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    PageSlot& slot = pageTable.at(page);
+    std::memmove(frame, slot.base, size);
+    slot.base = frame;
+    Tlb::shootdown(static_cast<uint32_t>(id), page);
+}
+
+uint64_t Process::takeReferences(std::vector<unsigned int>& pages) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    size_t first = pages.size();
+    if (context.touchedOverflow) {
+        // Too many for the log; fall back to the flags themselves
+        pageTable.forEach([&pages](uint64_t page, const PageSlot& slot) {
+            if (slot.flags & PageFlags::Referenced) {
+                pages.push_back(static_cast<unsigned int>(page));
+            }
+        });
+    }
+    else {
+        pages.insert(pages.end(), context.touchedPages, context.touchedPages + context.numTouchedPages);
+    }
+    for (size_t i = first; i < pages.size(); ++i) {
+        PageSlot* slot = pageTable.find(pages[i]);
+        if (slot != nullptr) {
+            slot->flags &= ~PageFlags::Referenced;
+        }
+    }
+    context.numTouchedPages = 0;
+    context.touchedOverflow = false;
+
+    uint64_t accesses = context.residentAccesses;
+    context.residentAccesses = 0;
+    return accesses;
+}
+
+void Process::setPageReadOnly(unsigned int page, bool readOnly) {
+    std::lock_guard<std::mutex> lock(programMutex);
+    PageSlot* slot = pageTable.find(page);
+    if (slot == nullptr) {
+        return;
+    }
+    if (readOnly) {
+        slot->flags |= PageFlags::ReadOnly;
+    }
+    else {
+        slot->flags &= ~PageFlags::ReadOnly;
+    }
+}
+
+bool Process::isPageReadOnly(unsigned int page) const {
+    std::lock_guard<std::mutex> lock(programMutex);
+    const PageSlot* slot = pageTable.find(page);
+    return slot != nullptr && (slot->flags & PageFlags::ReadOnly) != 0;
+}
+
+void Process::forkInto(Process& child, bool sharePages) {
+    // The child is not published yet, so nothing else can hold its lock
+    std::lock_guard<std::mutex> lock(programMutex);
+    std::lock_guard<std::mutex> childLock(child.programMutex);
+
+    child.program = program;
+    child.memorySize = memorySize;
+    child.context = context;
+    child.context.process = &child;
+    child.context.coreId = -1;
+    child.context.forkPending = false;
+    child.context.tlb = nullptr;
+    child.context.numTouchedPages = 0;
+    child.context.touchedOverflow = false;
+    child.context.residentAccesses = 0;
+
+    child.pageSize = pageSize;
+    if (sharePages) {
+        pageTable.forEach([](uint64_t, PageSlot& slot) {
+            if (slot.base != nullptr) {
+                slot.flags |= PageFlags::ReadOnly;
+            }
+        });
+        child.pageTable = pageTable;
+        child.residentMemory.store(residentMemory.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    else {
+        child.pageTable = SparseTable<PageSlot>(pageTable.size());
+    }
+    child.attachAddressSpace();
+
+    child.currentLine.store(currentLine.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    child.totalLines.store(totalLines.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+unsigned int Process::getResidentMemory() const {
+    return residentMemory.load(std::memory_order_relaxed);
+}
+
+uint32_t Process::getFaultAddress() const {
+    return context.faultAddress;
+}
+
+unsigned int Process::takeSleepTicks() {
+    std::lock_guard<std::mutex> lock(programMutex);
+    unsigned int ticks = context.sleepTicks;
+    context.sleepTicks = 0;
+    return ticks;
+}
+
+bool Process::hasAccessViolation() const {
+    return accessViolation.load(std::memory_order_acquire);
+}
+
+uint32_t Process::getViolationAddress() const {
+    return hasAccessViolation() ? violationAddress : 0;
+}
+
+std::time_t Process::getViolationTime() const {
+    return hasAccessViolation() ? violationTime : 0;
 }
 
 std::time_t Process::getCreationTime() const {
@@ -111,47 +362,75 @@ std::time_t Process::getCreationTime() const {
 }
 
 int Process::getCurrentLine() const {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    return currentLine;
+    return currentLine.load(std::memory_order_relaxed);
 }
 
 int Process::getTotalLines() const {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    return totalLines;
+    return totalLines.load(std::memory_order_relaxed);
 }
 
 std::string Process::getCurrentCodeLine() const {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    if (currentLine > 0 && currentLine <= totalLines) {
-        return codeLines[currentLine - 1];
-    }
-    else {
+    if (getCurrentLine() == 0) {
         return "No code line is currently being executed.";
     }
-}
 
-bool Process::isCompleted() const {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    return completed;
+    std::lock_guard<std::mutex> lock(programMutex);
+    std::string line;
+    appendExpanded(line, program->describe(context.lastPc), name);
+    return line;
 }
 
-void Process::incrementCurrentLine() {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    currentLine++;
+bool Process::isCompleted() const {
+    return completed.load(std::memory_order_acquire);
 }
 
 void Process::setCompleted(bool value) {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    completed = value;
+    if (value) {
+        finishTime.store(std::time(nullptr), std::memory_order_relaxed);
+    }
+    completed.store(value, std::memory_order_release);
+    updateRanking();
 }
 
 void Process::resetCompleted() {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    completed = false;
+    completed.store(false, std::memory_order_release);
+    updateRanking();
+}
+
+std::time_t Process::getFinishTime() const {
+    return finishTime.load(std::memory_order_relaxed);
 }
 
-void Process::setLoggingEnabled(bool enabled) {
-    loggingEnabled = enabled;
+void Process::setAttached(bool attached) {
+    this->attached.store(attached, std::memory_order_release);
+}
+
+bool Process::isAttached() const {
+    return attached.load(std::memory_order_acquire);
+}
+
+void Process::setRanking(ProcessRanking* ranking) {
+    this->ranking.store(ranking, std::memory_order_release);
+}
+
+void Process::updateRanking() {
+    // Only marks the process; the monitor reading the ranking re-reads it
+    ProcessRanking* current = ranking.load(std::memory_order_acquire);
+    if (current != nullptr) {
+        current->markChanged(id);
+    }
+}
+
+void Process::setLoggingEnabled(bool enabled, bool binary) {
+    if (enabled) {
+        LogWriter::getInstance().start(binary ? LogFormat::Binary : LogFormat::Text);
+        loggingEnabled = true;
+    }
+    else {
+        // Stopping drains whatever the cores have already queued
+        loggingEnabled = false;
+        LogWriter::getInstance().stop();
+    }
 }
 
 bool Process::isLoggingEnabled() {
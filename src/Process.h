@@ -1,16 +1,19 @@
 #pragma once
 
 #include <string>
-#include <queue>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <vector>
+#include <memory>
+#include "Interpreter.h"
+#include "Program.h"
 
-class Command;
+class ProcessRanking;
 
 class Process {
 public:
-    Process(const std::string& name);
+    Process(const std::string& name, int id);
     ~Process();
 
     const std::string& getName() const;
@@ -22,10 +25,60 @@ public:
     void setInMemory(bool inMemory);
     bool isInMemory() const;
 
-    void addCommand(Command* cmd);
-    Command* getNextCommand();
-
+    void loadProgram(std::shared_ptr<Program> program);
+    void appendPrint(const std::string& message);
+
+    // Executes the next instruction line on the given core
+    Interpreter::StepResult executeNextInstruction(int coreId);
+    bool hasRemainingInstructions() const;
+
+    // Emulated address space, mapped page by page by MemoryManager
+    void initAddressSpace(unsigned int pageSize);
+    unsigned int getPageSize() const;
+    unsigned int getNumPages() const;
+    void mapPage(unsigned int page, uint8_t* frame, bool readOnly = false, bool dirty = false);
+    bool unmapPage(unsigned int page);      // true if the page was written while resident
+
+    // Copies a resident page's contents to frame and remaps it there, with
+    // the process unable to run in between. The two may overlap.
+    void movePage(unsigned int page, uint8_t* frame, size_t size);
+
+    // Appends the pages referenced since the last call and clears their
+    // Referenced flags. Returns the number of accesses that found their
+    // page resident over the same period.
+    uint64_t takeReferences(std::vector<unsigned int>& pages);
+    void setPageReadOnly(unsigned int page, bool readOnly);
+    bool isPageReadOnly(unsigned int page) const;
+    uint32_t getFaultAddress() const;       // only valid on the core that took the fault
+
+    // Returns the SLEEP ticks still owed after a step came back Sleeping
+    // and clears them, so the process can wait off the core
+    unsigned int takeSleepTicks();
+
+    // Bytes of the address space currently backed by frames, kept by
+    // mapPage/unmapPage so monitors can read it without any lock
+    unsigned int getResidentMemory() const;
+
+    // Copies the program position, line counts and address space into a
+    // freshly constructed child. The child shares the parent's Program.
+    // With sharePages, resident pages are mapped into both processes
+    // read-only so the first write to each takes a copy-on-write fault;
+    // otherwise the child starts with nothing resident.
+    void forkInto(Process& child, bool sharePages);
+
+    bool hasAccessViolation() const;
+    uint32_t getViolationAddress() const;
+    std::time_t getViolationTime() const;
+
+    // Programs are shared between processes, so PRINT text names the
+    // process with kNamePlaceholder. log passes it through as is and the
+    // log writer fills in the name, off the core's time slice.
+    static constexpr const char* kNamePlaceholder = "{process}";
     void log(const std::string& message, int coreId);
+    void log(const std::string& message, uint16_t value, int coreId);   // message followed by value
+
+    // Appends message to out with every kNamePlaceholder replaced by name
+    static void appendExpanded(std::string& out, const std::string& message, const std::string& name);
 
     std::time_t getCreationTime() const;
 
@@ -36,33 +89,58 @@ public:
     bool isCompleted() const;
     void setCompleted(bool value);
     void resetCompleted();
-    void incrementCurrentLine();
+    std::time_t getFinishTime() const;
+
+    // A process open in a screen session is never retired
+    void setAttached(bool attached);
+    bool isAttached() const;
+
+    // Set by the process table while the process is published; the
+    // ranking is marked whenever progress, residency or completion changes
+    void setRanking(ProcessRanking* ranking);
 
-    static void setLoggingEnabled(bool enabled);
+    // binary selects the mapped segment log instead of per-process text files
+    static void setLoggingEnabled(bool enabled, bool binary = false);
     static bool isLoggingEnabled();
 
 private:
     std::string name;
     int id;
 
-    static int nextId;
-
     unsigned int memorySize;
-    bool inMemory;
-
-    std::queue<Command*> commandQueue;
-    mutable std::mutex queueMutex;
 
-    std::chrono::system_clock::time_point creationTime;
+    std::shared_ptr<Program> program;
+    ExecutionContext context;
+    mutable std::mutex programMutex;
 
-    std::vector<std::string> codeLines;
-    int currentLine;
-    int totalLines;
-    bool completed;
+    void attachAddressSpace();
+    void updateRanking();
+    unsigned int pageSize;
+    SparseTable<PageSlot> pageTable;   // slots exist only for pages that were mapped
 
-    mutable std::mutex stateMutex;
+    // Written before accessViolation is published
+    uint32_t violationAddress;
+    std::time_t violationTime;
 
-    std::mutex logMutex;
+    std::chrono::system_clock::time_point creationTime;
 
-    static bool loggingEnabled;
+    // Hot control-block fields. Monitors read them without locking; only
+    // the core running the process advances currentLine, so it uses a
+    // plain load/store pair instead of a read-modify-write.
+    std::atomic<int> currentLine;
+    std::atomic<int> totalLines;
+    std::atomic<bool> completed;
+    std::atomic<bool> inMemory;
+    std::atomic<unsigned int> residentMemory;
+    std::atomic<bool> accessViolation;
+    std::atomic<std::time_t> finishTime;
+    std::atomic<bool> attached;
+
+    std::atomic<ProcessRanking*> ranking;
+    uint32_t rankedProgress;    // progress bucket last reported; only the running core touches it
+
+    // Orders this process's log records across the cores it runs on
+    std::atomic<uint32_t> logSequence;
+
+    static std::atomic<bool> loggingEnabled;
 };
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "ProcessArchive.h"
+#include "Process.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+constexpr size_t ProcessArchive::kMaxInMemory;
+
+namespace {
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+} // namespace
+
+ProcessSummary ProcessSummary::fromProcess(const Process& process) {
+    ProcessSummary summary;
+    summary.id = process.getId();
+    summary.name = process.getName();
+    summary.creationTime = process.getCreationTime();
+    summary.finishTime = process.getFinishTime();
+    summary.executedLines = process.getCurrentLine();
+    summary.totalLines = process.getTotalLines();
+    summary.accessViolation = process.hasAccessViolation();
+    return summary;
+}
+
+ProcessArchive::ProcessArchive(const std::string& filename)
+    : filename(filename), fileCreated(false), numSpilled(0), spilledBytes(0) {}
+
+void ProcessArchive::add(const ProcessSummary& summary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.push_back(summary);
+    if (recent.size() > kMaxInMemory) {
+        // Spill in batches so the file is not reopened for every retirement
+        spill(kMaxInMemory / 2);
+    }
+}
+
+std::vector<ProcessSummary> ProcessArchive::getSummaries() const {
+    std::vector<ProcessSummary> result;
+    result.reserve(size());
+    forEachSummary(0, [&result](const ProcessSummary& summary) {
+        result.push_back(summary);
+    });
+    return result;
+}
+
+size_t ProcessArchive::forEachSummary(size_t fromIndex, const std::function<void(const ProcessSummary&)>& visitor) const {
+    size_t index = fromIndex;
+    while (true) {
+        size_t spilled;
+        size_t batchIndex;
+        std::streamoff batchOffset;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (index >= numSpilled) {
+                for (size_t i = index - numSpilled; i < recent.size(); ++i) {
+                    visitor(recent[i]);
+                }
+                return numSpilled + recent.size();
+            }
+            spilled = numSpilled;
+            auto batch = std::upper_bound(spilledBatches.begin(), spilledBatches.end(), index,
+                [](size_t value, const std::pair<size_t, std::streamoff>& entry) { return value < entry.first; });
+            --batch;
+            batchIndex = batch->first;
+            batchOffset = batch->second;
+        }
+
+        // Spilled records never change once written, and a concurrent spill
+        // only appends, so the file is read without holding up retirement.
+        // Anything spilled meanwhile is picked up on the next pass.
+        std::ifstream file(filename, std::ios::binary);
+        file.seekg(batchOffset);
+        ProcessSummary summary;
+        for (size_t i = batchIndex; i < spilled; ++i) {
+            if (!readRecord(file, summary)) {
+                return index;
+            }
+            if (i >= index) {
+                visitor(summary);
+            }
+        }
+        index = spilled;
+    }
+}
+
+size_t ProcessArchive::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numSpilled + recent.size();
+}
+
+void ProcessArchive::spill(size_t count) {
+    // Each session starts with an empty archive, created only once needed
+    std::ofstream file(filename, std::ios::binary | (fileCreated ? std::ios::app : std::ios::trunc));
+    if (!file.is_open()) {
+        std::cerr << "Failed to open process archive " << filename << std::endl;
+        return;
+    }
+    fileCreated = true;
+    spilledBatches.emplace_back(numSpilled, spilledBytes);
+    for (size_t i = 0; i < count && !recent.empty(); ++i) {
+        writeRecord(file, recent.front());
+        recent.pop_front();
+        numSpilled++;
+    }
+    spilledBytes = file.tellp();
+}
+
+void ProcessArchive::writeRecord(std::ostream& out, const ProcessSummary& summary) {
+    writeValue<int32_t>(out, summary.id);
+    writeValue<int64_t>(out, summary.creationTime);
+    writeValue<int64_t>(out, summary.finishTime);
+    writeValue<int32_t>(out, summary.executedLines);
+    writeValue<int32_t>(out, summary.totalLines);
+    writeValue<uint8_t>(out, summary.accessViolation ? 1 : 0);
+    writeValue<uint16_t>(out, static_cast<uint16_t>(summary.name.size()));
+    out.write(summary.name.data(), static_cast<std::streamsize>(static_cast<uint16_t>(summary.name.size())));
+}
+
+bool ProcessArchive::readRecord(std::istream& in, ProcessSummary& summary) {
+    int32_t id, executedLines, totalLines;
+    int64_t creationTime, finishTime;
+    uint8_t flags;
+    uint16_t nameLength;
+    if (!readValue(in, id) || !readValue(in, creationTime) || !readValue(in, finishTime)
+        || !readValue(in, executedLines) || !readValue(in, totalLines)
+        || !readValue(in, flags) || !readValue(in, nameLength)) {
+        return false;
+    }
+    summary.name.resize(nameLength);
+    if (nameLength > 0 && !in.read(&summary.name[0], nameLength)) {
+        return false;
+    }
+    summary.id = id;
+    summary.creationTime = static_cast<std::time_t>(creationTime);
+    summary.finishTime = static_cast<std::time_t>(finishTime);
+    summary.executedLines = executedLines;
+    summary.totalLines = totalLines;
+    summary.accessViolation = (flags & 1) != 0;
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <ios>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Process;
+
+// What is kept of a finished process once its Process object is freed
+struct ProcessSummary {
+    int id;
+    std::string name;
+    std::time_t creationTime;
+    std::time_t finishTime;
+    int executedLines;
+    int totalLines;
+    bool accessViolation;
+
+    static ProcessSummary fromProcess(const Process& process);
+};
+
+// Summaries of retired processes. The most recent ones are held in memory;
+// older ones are appended to a compact binary file so long-running tests
+// keep a bounded footprint.
+class ProcessArchive {
+public:
+    static constexpr size_t kMaxInMemory = 4096;
+
+    explicit ProcessArchive(const std::string& filename = "process-archive.bin");
+
+    void add(const ProcessSummary& summary);
+
+    // Every archived summary, oldest first, including spilled ones
+    std::vector<ProcessSummary> getSummaries() const;
+    size_t size() const;
+
+    // Visits summaries in archive order starting at index fromIndex, without
+    // collecting them first. Spilled records are read from the file outside
+    // the lock; the in-memory ones are visited under it, so the visitor must
+    // not call back into the archive. Returns the index after the last one.
+    size_t forEachSummary(size_t fromIndex, const std::function<void(const ProcessSummary&)>& visitor) const;
+
+private:
+    void spill(size_t count);
+    static void writeRecord(std::ostream& out, const ProcessSummary& summary);
+    static bool readRecord(std::istream& in, ProcessSummary& summary);
+
+    std::string filename;
+    bool fileCreated;       // the first spill truncates what a previous session left
+    std::deque<ProcessSummary> recent;
+    size_t numSpilled;
+
+    // Index and file offset of the first record of each spilled batch, so a
+    // visit can seek close to where it starts
+    std::vector<std::pair<size_t, std::streamoff>> spilledBatches;
+    std::streamoff spilledBytes;
+    mutable std::mutex mutex;
+};
@@ -0,0 +1,173 @@
+#include "ProcessRanking.h"
+#include "Process.h"
+#include "ProcessTable.h"
+
+constexpr uint32_t ProcessRanking::kProgressBuckets;
+constexpr int ProcessRanking::kChunkSize;
+
+ProcessRanking::ProcessRanking(const ProcessTable& table, int maxPid)
+    : table(table), maxPid(maxPid), numChunks(maxPid / kChunkSize + 1),
+      chunks(new std::atomic<Chunk*>[maxPid / kChunkSize + 1]),
+      numFinished(0), residentTotal(0), sweepChunk(0) {
+    for (int i = 0; i < numChunks; ++i) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ProcessRanking::~ProcessRanking() {
+    for (int i = 0; i < numChunks; ++i) {
+        delete chunks[i].load();
+    }
+}
+
+void ProcessRanking::markChanged(int processId) {
+    if (processId < 0 || processId > maxPid) {
+        return;
+    }
+    Chunk* chunk = chunkFor(processId);
+    chunk->changed[processId % kChunkSize].store(true, std::memory_order_relaxed);
+    chunk->anyChanged.store(true, std::memory_order_release);
+}
+
+void ProcessRanking::refresh() {
+    int nextSweep = -1;
+    for (int i = 0; i < numChunks; ++i) {
+        Chunk* chunk = chunks[i].load(std::memory_order_acquire);
+        if (chunk == nullptr) continue;
+        if (nextSweep < 0 && i > sweepChunk) {
+            nextSweep = i;
+        }
+
+        // Taking the summary pairs with the marking thread's store, but a
+        // mark can still be missed when another process in the chunk marked
+        // after it. Its flag stays set, so one chunk a pass is checked whole
+        // and such a mark waits at most a sweep.
+        if (!chunk->anyChanged.exchange(false, std::memory_order_acquire) && i != sweepChunk) {
+            continue;
+        }
+        for (int slot = 0; slot < kChunkSize; ++slot) {
+            std::atomic<bool>& changed = chunk->changed[slot];
+            if (changed.load(std::memory_order_relaxed) && changed.exchange(false, std::memory_order_acquire)) {
+                refreshProcess(i * kChunkSize + slot);
+            }
+        }
+    }
+    sweepChunk = nextSweep;
+    if (sweepChunk < 0) {
+        // Wrap around to the first chunk in use
+        sweepChunk = 0;
+        while (sweepChunk < numChunks && chunks[sweepChunk].load(std::memory_order_acquire) == nullptr) {
+            sweepChunk++;
+        }
+    }
+}
+
+void ProcessRanking::topByProgress(size_t maxRows, std::vector<Process*>& rows) const {
+    top(byProgress, maxRows, rows);
+}
+
+void ProcessRanking::topByMemory(size_t maxRows, std::vector<Process*>& rows) const {
+    top(byMemory, maxRows, rows);
+}
+
+size_t ProcessRanking::getNumFinished() const {
+    return numFinished;
+}
+
+unsigned long long ProcessRanking::getResidentTotal() const {
+    return residentTotal;
+}
+
+uint32_t ProcessRanking::progressBucket(int currentLine, int totalLines) {
+    if (totalLines <= 0 || currentLine <= 0) {
+        return 0;
+    }
+    if (currentLine >= totalLines) {
+        return kProgressBuckets;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(currentLine) * kProgressBuckets / totalLines);
+}
+
+ProcessRanking::Chunk* ProcessRanking::chunkFor(int id) {
+    std::atomic<Chunk*>& entry = chunks[id / kChunkSize];
+    Chunk* chunk = entry.load(std::memory_order_acquire);
+    if (chunk != nullptr) {
+        return chunk;
+    }
+
+    // The table publishes a process before it can mark itself, so this
+    // runs on the publishing thread, not on a core
+    Chunk* fresh = new Chunk();
+    fresh->anyChanged.store(false, std::memory_order_relaxed);
+    for (int slot = 0; slot < kChunkSize; ++slot) {
+        fresh->changed[slot].store(false, std::memory_order_relaxed);
+    }
+    if (entry.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+        return fresh;
+    }
+    // Another thread installed the chunk first
+    delete fresh;
+    return chunk;
+}
+
+void ProcessRanking::refreshProcess(int id) {
+    Process* process = table.findById(id);
+    auto it = ranked.find(id);
+    if (it != ranked.end() && it->second.process != process) {
+        // Retired, or the PID now belongs to another process
+        erase(id, it->second);
+        ranked.erase(it);
+        it = ranked.end();
+    }
+    if (process == nullptr) {
+        return;
+    }
+
+    Keys keys;
+    keys.process = process;
+    keys.progress = progressBucket(process->getCurrentLine(), process->getTotalLines());
+    keys.memory = process->getResidentMemory();
+    keys.finished = process->isCompleted();
+    if (it != ranked.end()) {
+        const Keys& old = it->second;
+        if (keys.progress == old.progress && keys.memory == old.memory && keys.finished == old.finished) {
+            return;
+        }
+        erase(id, old);
+        it->second = keys;
+    }
+    else {
+        ranked.emplace(id, keys);
+    }
+    insert(id, keys);
+}
+
+void ProcessRanking::insert(int id, const Keys& keys) {
+    byProgress.insert({ keys.progress, id });
+    byMemory.insert({ keys.memory, id });
+    residentTotal += keys.memory;
+    if (keys.finished) {
+        numFinished++;
+    }
+}
+
+void ProcessRanking::erase(int id, const Keys& keys) {
+    byProgress.erase({ keys.progress, id });
+    byMemory.erase({ keys.memory, id });
+    residentTotal -= keys.memory;
+    if (keys.finished) {
+        numFinished--;
+    }
+}
+
+void ProcessRanking::top(const std::set<Entry>& index, size_t maxRows, std::vector<Process*>& rows) const {
+    size_t taken = 0;
+    for (auto it = index.begin(); it != index.end() && taken < maxRows; ++it) {
+        // A missed mark can leave a retired process here until its sweep;
+        // only the pointer is compared, so it is never dereferenced
+        Process* process = ranked.at(it->id).process;
+        if (table.findById(it->id) != process) continue;
+        rows.push_back(process);
+        taken++;
+    }
+}
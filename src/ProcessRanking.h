@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+class Process;
+class ProcessTable;
+
+// Published processes kept in order of progress and of resident memory,
+// so monitors can read the top rows without visiting every process.
+// Progress is ranked in kProgressBuckets steps and resident memory
+// exactly; ties go to the lower PID.
+//
+// A process only marks itself changed, with plain stores to a flag for its
+// PID and a summary flag for its chunk of PIDs. The monitor thread calls
+// refresh, which skips quiet chunks, re-reads the counters of the marked
+// processes and moves just those in the index. Progress only marks when
+// the bucket changes. The index is the monitor thread's alone: refresh,
+// the top queries and the totals must not be called from two threads at
+// once.
+class ProcessRanking {
+public:
+    static constexpr uint32_t kProgressBuckets = 1000;
+    static constexpr int kChunkSize = 4096;
+
+    ProcessRanking(const ProcessTable& table, int maxPid);
+    ~ProcessRanking();
+
+    ProcessRanking(const ProcessRanking&) = delete;
+    ProcessRanking& operator=(const ProcessRanking&) = delete;
+
+    // Safe from any thread; never blocks
+    void markChanged(int processId);
+
+    // Brings the index up to date with the table. The caller keeps retired
+    // processes from being freed until it is done with the rows.
+    void refresh();
+
+    // Appends at most maxRows processes, highest ranked first, skipping
+    // any that left the table since the last refresh
+    void topByProgress(size_t maxRows, std::vector<Process*>& rows) const;
+    void topByMemory(size_t maxRows, std::vector<Process*>& rows) const;
+
+    size_t getNumFinished() const;
+    unsigned long long getResidentTotal() const;    // bytes, summed over the ranked processes
+
+    static uint32_t progressBucket(int currentLine, int totalLines);
+
+private:
+    struct Chunk {
+        std::atomic<bool> anyChanged;
+        std::atomic<bool> changed[kChunkSize];
+    };
+
+    struct Keys {
+        Process* process;
+        uint32_t progress;
+        uint32_t memory;
+        bool finished;
+    };
+
+    struct Entry {
+        uint32_t key;
+        int id;
+
+        bool operator<(const Entry& other) const {
+            if (key != other.key) return key > other.key;
+            return id < other.id;
+        }
+    };
+
+    Chunk* chunkFor(int id);
+    void refreshProcess(int id);
+    void insert(int id, const Keys& keys);
+    void erase(int id, const Keys& keys);
+    void top(const std::set<Entry>& index, size_t maxRows, std::vector<Process*>& rows) const;
+
+    const ProcessTable& table;
+    int maxPid;
+    int numChunks;
+    std::unique_ptr<std::atomic<Chunk*>[]> chunks;     // chunk i holds PIDs [i*kChunkSize, (i+1)*kChunkSize)
+
+    // Monitor-thread state
+    std::unordered_map<int, Keys> ranked;
+    std::set<Entry> byProgress;
+    std::set<Entry> byMemory;
+    size_t numFinished;
+    unsigned long long residentTotal;
+    int sweepChunk;     // rechecked whole on the next refresh, whatever its summary says
+};
@@ -0,0 +1,158 @@
+#include "ProcessTable.h"
+#include "Process.h"
+#include <functional>
+
+constexpr size_t ProcessTable::kNumShards;
+constexpr int ProcessTable::kChunkSize;
+
+ProcessTable::ProcessTable(int maxPid)
+    : maxPid(maxPid), numChunks(maxPid / kChunkSize + 1),
+      chunks(new std::atomic<Chunk*>[maxPid / kChunkSize + 1]), numPublished(0), ranking(*this, maxPid) {
+    for (int i = 0; i < numChunks; ++i) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ProcessTable::~ProcessTable() {
+    for (int i = 0; i < numChunks; ++i) {
+        delete[] chunks[i].load();
+    }
+}
+
+bool ProcessTable::reserve(const std::string& name) {
+    NameShard& shard = nameShard(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.processes.emplace(name, nullptr).second;
+}
+
+void ProcessTable::publish(Process* process) {
+    int id = process->getId();
+    chunkFor(id)[id % kChunkSize].store(process, std::memory_order_release);
+    numPublished++;
+    process->setRanking(&ranking);
+    ranking.markChanged(id);
+
+    NameShard& shard = nameShard(process->getName());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.processes[process->getName()] = process;
+}
+
+void ProcessTable::publishBatch(const std::vector<Process*>& processes) {
+    for (Process* process : processes) {
+        int id = process->getId();
+        chunkFor(id)[id % kChunkSize].store(process, std::memory_order_release);
+        process->setRanking(&ranking);
+        ranking.markChanged(id);
+    }
+    numPublished += processes.size();
+
+    // Group the name updates so each shard is locked once
+    std::vector<Process*> byShard[kNumShards];
+    for (Process* process : processes) {
+        byShard[std::hash<std::string>()(process->getName()) % kNumShards].push_back(process);
+    }
+    for (size_t i = 0; i < kNumShards; ++i) {
+        if (byShard[i].empty()) continue;
+        std::lock_guard<std::mutex> lock(nameShards[i].mutex);
+        for (Process* process : byShard[i]) {
+            nameShards[i].processes[process->getName()] = process;
+        }
+    }
+}
+
+void ProcessTable::release(const std::string& name) {
+    NameShard& shard = nameShard(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.processes.find(name);
+    if (it != shard.processes.end() && it->second == nullptr) {
+        shard.processes.erase(it);
+    }
+}
+
+void ProcessTable::remove(Process* process) {
+    {
+        NameShard& shard = nameShard(process->getName());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.processes.erase(process->getName());
+    }
+
+    int id = process->getId();
+    Chunk* chunk = chunks[id / kChunkSize].load(std::memory_order_acquire);
+    if (chunk != nullptr && chunk[id % kChunkSize].exchange(nullptr, std::memory_order_acq_rel) == process) {
+        numPublished--;
+    }
+    process->setRanking(nullptr);
+    ranking.markChanged(id);
+}
+
+Process* ProcessTable::findByName(const std::string& name) const {
+    const NameShard& shard = nameShard(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.processes.find(name);
+    return it != shard.processes.end() ? it->second : nullptr;
+}
+
+Process* ProcessTable::findById(int id) const {
+    if (id < 0 || id > maxPid) {
+        return nullptr;
+    }
+    Chunk* chunk = chunks[id / kChunkSize].load(std::memory_order_acquire);
+    return chunk != nullptr ? chunk[id % kChunkSize].load(std::memory_order_acquire) : nullptr;
+}
+
+std::vector<Process*> ProcessTable::snapshot() const {
+    std::vector<Process*> result;
+    result.reserve(size());
+    forEach([&result](Process* process) {
+        result.push_back(process);
+    });
+    return result;
+}
+
+void ProcessTable::forEach(const std::function<void(Process*)>& visitor) const {
+    for (int i = 0; i < numChunks; ++i) {
+        Chunk* chunk = chunks[i].load(std::memory_order_acquire);
+        if (chunk == nullptr) continue;
+        for (int slot = 0; slot < kChunkSize; ++slot) {
+            Process* process = chunk[slot].load(std::memory_order_acquire);
+            if (process != nullptr) {
+                visitor(process);
+            }
+        }
+    }
+}
+
+ProcessRanking& ProcessTable::getRanking() {
+    return ranking;
+}
+
+size_t ProcessTable::size() const {
+    return numPublished.load();
+}
+
+ProcessTable::Chunk* ProcessTable::chunkFor(int id) {
+    std::atomic<Chunk*>& entry = chunks[id / kChunkSize];
+    Chunk* chunk = entry.load(std::memory_order_acquire);
+    if (chunk != nullptr) {
+        return chunk;
+    }
+
+    Chunk* fresh = new Chunk[kChunkSize];
+    for (int slot = 0; slot < kChunkSize; ++slot) {
+        fresh[slot].store(nullptr, std::memory_order_relaxed);
+    }
+    if (entry.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+        return fresh;
+    }
+    // Another thread installed the chunk first
+    delete[] fresh;
+    return chunk;
+}
+
+ProcessTable::NameShard& ProcessTable::nameShard(const std::string& name) {
+    return nameShards[std::hash<std::string>()(name) % kNumShards];
+}
+
+const ProcessTable::NameShard& ProcessTable::nameShard(const std::string& name) const {
+    return nameShards[std::hash<std::string>()(name) % kNumShards];
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ProcessRanking.h"
+
+class Process;
+
+// Process registry. Names are sharded, each shard with its own lock; PIDs
+// index directly into atomic slots, so lookup by PID and snapshots never
+// lock. Slots are allocated in chunks on first use, so a large PID space
+// costs memory only where PIDs have been issued.
+class ProcessTable {
+public:
+    static constexpr size_t kNumShards = 16;
+
+    static constexpr int kChunkSize = 4096;
+
+    explicit ProcessTable(int maxPid);
+    ~ProcessTable();
+
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    // Claims a name before the process is admitted. Returns false if the
+    // name is taken. A reserved name is not visible to lookups until it
+    // is published, and must be either published or released.
+    bool reserve(const std::string& name);
+    void publish(Process* process);
+    void publishBatch(const std::vector<Process*>& processes);
+    void release(const std::string& name);
+    void remove(Process* process);
+
+    Process* findByName(const std::string& name) const;
+    Process* findById(int id) const;
+
+    // Published processes ordered by PID. Slots are read one at a time,
+    // so the result is not a global cut.
+    std::vector<Process*> snapshot() const;
+    size_t size() const;
+
+    // Visits the same processes as snapshot() without collecting them first
+    void forEach(const std::function<void(Process*)>& visitor) const;
+
+    // Published processes in ranked order, for monitors
+    ProcessRanking& getRanking();
+
+private:
+    struct NameShard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Process*> processes;   // nullptr while reserved
+    };
+
+    NameShard& nameShard(const std::string& name);
+    const NameShard& nameShard(const std::string& name) const;
+
+    using Chunk = std::atomic<Process*>;
+    Chunk* chunkFor(int id);
+
+    NameShard nameShards[kNumShards];
+    int maxPid;
+    int numChunks;
+    std::unique_ptr<std::atomic<Chunk*>[]> chunks;     // chunk i holds PIDs [i*kChunkSize, (i+1)*kChunkSize)
+    std::atomic<size_t> numPublished;
+    ProcessRanking ranking;
+};
@@ -0,0 +1,205 @@
+#include "ProcessWatch.h"
+#include "Config.h"
+#include "ConsoleManager.h"
+#include "Process.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+
+const size_t kWidth = 80;
+const size_t kHeaderLines = 5;
+
+// Changed cells closer than this are rewritten together; one cursor move
+// costs about as much as the unchanged characters in between
+const size_t kMergeGap = 6;
+
+std::string padded(const char* text) {
+    std::string line(text);
+    line.resize(kWidth, ' ');
+    return line;
+}
+
+} // namespace
+
+ProcessWatch::ProcessWatch(ConsoleManager& consoleManager, SortKey sortKey, size_t maxRows)
+    : consoleManager(consoleManager), sortKey(sortKey), maxRows(maxRows), running(false) {
+    top.reserve(maxRows);
+    frame.assign(kHeaderLines + maxRows, std::string(kWidth, ' '));
+    previousFrame = frame;
+}
+
+void ProcessWatch::run(std::chrono::milliseconds interval) {
+#ifdef _WIN32
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD originalMode = 0;
+    bool restoreMode = GetConsoleMode(console, &originalMode) != 0;
+    if (restoreMode) {
+        SetConsoleMode(console, originalMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(consoleManager.getIOMutex());
+        // Clear the screen and hide the cursor; the blank previous frame
+        // then matches what the terminal shows
+        std::cout << "\x1b[2J\x1b[H\x1b[?25l";
+        std::cout.flush();
+    }
+
+    running.store(true);
+    std::thread refreshThread(&ProcessWatch::refreshLoop, this, interval);
+
+    std::string line;
+    std::getline(std::cin, line);
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running.store(false);
+    }
+    wakeCondition.notify_all();
+    refreshThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(consoleManager.getIOMutex());
+        std::cout << "\x1b[" << (frame.size() + 1) << ";1H\x1b[?25h\n";
+        std::cout.flush();
+    }
+
+#ifdef _WIN32
+    if (restoreMode) {
+        SetConsoleMode(console, originalMode);
+    }
+#endif
+}
+
+void ProcessWatch::refreshLoop(std::chrono::milliseconds interval) {
+    while (running.load()) {
+        buildFrame(interval);
+        render();
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait_for(lock, interval, [this]() { return !running.load(); });
+    }
+}
+
+void ProcessWatch::buildFrame(std::chrono::milliseconds interval) {
+    Scheduler* scheduler = consoleManager.getScheduler();
+    std::map<Process*, int> runningProcesses = scheduler->getRunningProcesses();
+
+    // Only this thread maintains the ranking; the cores just mark what changed
+    ConsoleManager::ProcessHold hold(consoleManager);
+    ProcessRanking& ranking = consoleManager.getProcessRanking();
+    ranking.refresh();
+    top.clear();
+    if (sortKey == SortKey::Cpu) {
+        ranking.topByProgress(maxRows, top);
+    }
+    else {
+        ranking.topByMemory(maxRows, top);
+    }
+    size_t numProcesses = consoleManager.getNumProcesses();
+    size_t numFinished = ranking.getNumFinished();
+    unsigned long long residentTotal = ranking.getResidentTotal();
+
+    Config& config = Config::getInstance();
+    unsigned int totalMemory = config.getMaxOverallMem();
+    int totalCores = scheduler->getTotalCores();
+    int busyCores = scheduler->getBusyCores();
+    char text[256];
+
+    std::snprintf(text, sizeof(text), "PROCESS-SMI watch   every %lld ms   sorted by %s   top %zu   (Enter to stop)",
+        static_cast<long long>(interval.count()), sortKey == SortKey::Cpu ? "cpu" : "memory", maxRows);
+    frame[0] = padded(text);
+    std::snprintf(text, sizeof(text), "CPU Usage : %5.1f%%  (%d / %d cores)      Memory : %llu / %u KB  (%5.1f%%)",
+        totalCores > 0 ? 100.0 * busyCores / totalCores : 0.0, busyCores, totalCores,
+        residentTotal, totalMemory, totalMemory > 0 ? 100.0 * residentTotal / totalMemory : 0.0);
+    frame[1] = padded(text);
+    std::snprintf(text, sizeof(text), "Processes : %zu   running %zu   ready %zu   finished %zu",
+        numProcesses, runningProcesses.size(),
+        numProcesses - std::min(numProcesses, numFinished + runningProcesses.size()), numFinished);
+    frame[2] = padded(text);
+    frame[3] = padded("");
+    std::snprintf(text, sizeof(text), "%7s  %-20s  %-8s  %-19s  %6s  %9s",
+        "PID", "Process Name", "State", "Progress", "CPU %", "Memory KB");
+    frame[4] = padded(text);
+
+    for (size_t i = 0; i < maxRows; ++i) {
+        if (i >= top.size()) {
+            frame[kHeaderLines + i] = padded("");
+            continue;
+        }
+        Process* process = top[i];
+        int currentLine = process->getCurrentLine();
+        int totalLines = process->getTotalLines();
+
+        char state[16];
+        auto runningIt = runningProcesses.find(process);
+        if (process->isCompleted()) {
+            std::snprintf(state, sizeof(state), "%s", process->hasAccessViolation() ? "Killed" : "Done");
+        }
+        else if (runningIt != runningProcesses.end()) {
+            std::snprintf(state, sizeof(state), "Core %d", runningIt->second);
+        }
+        else {
+            std::snprintf(state, sizeof(state), "Ready");
+        }
+
+        std::string name = process->getName();
+        if (name.length() > 20) {
+            name = name.substr(0, 17) + "...";
+        }
+        char progress[32];
+        std::snprintf(progress, sizeof(progress), "%d / %d", currentLine, totalLines);
+
+        std::snprintf(text, sizeof(text), "%7d  %-20s  %-8s  %-19s  %5.1f%%  %9u",
+            process->getId(), name.c_str(), state, progress,
+            totalLines > 0 ? 100.0 * currentLine / totalLines : 0.0, process->getResidentMemory());
+        frame[kHeaderLines + i] = padded(text);
+    }
+}
+
+void ProcessWatch::render() {
+    output.clear();
+    char move[48];
+
+    for (size_t line = 0; line < frame.size(); ++line) {
+        const std::string& next = frame[line];
+        std::string& shown = previousFrame[line];
+
+        size_t column = 0;
+        while (column < kWidth) {
+            if (next[column] == shown[column]) {
+                column++;
+                continue;
+            }
+            // Extend the run over changed cells and short unchanged gaps
+            size_t end = column + 1;
+            size_t lastChanged = column;
+            while (end < kWidth && end - lastChanged <= kMergeGap) {
+                if (next[end] != shown[end]) lastChanged = end;
+                end++;
+            }
+            std::snprintf(move, sizeof(move), "\x1b[%zu;%zuH", line + 1, column + 1);
+            output += move;
+            output.append(next, column, lastChanged + 1 - column);
+            column = lastChanged + 1;
+        }
+        shown = next;
+    }
+    if (output.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(consoleManager.getIOMutex());
+    std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+    std::cout.flush();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ConsoleManager;
+class Process;
+
+// Live, top-style view for process-smi -w. Each refresh brings the process
+// ranking up to date with the processes that changed and reads only the
+// top rows and the totals from it, so its cost does not grow with the
+// number of processes. It redraws only the cells that changed since the
+// previous frame using ANSI cursor movement.
+class ProcessWatch {
+public:
+    enum class SortKey {
+        Cpu,        // fraction of instruction lines executed
+        Memory      // resident bytes
+    };
+
+    ProcessWatch(ConsoleManager& consoleManager, SortKey sortKey, size_t maxRows);
+
+    // Refreshes every interval until a line is entered at the console
+    void run(std::chrono::milliseconds interval);
+
+private:
+    void refreshLoop(std::chrono::milliseconds interval);
+    void buildFrame(std::chrono::milliseconds interval);
+    void render();
+
+    ConsoleManager& consoleManager;
+    SortKey sortKey;
+    size_t maxRows;
+
+    std::vector<Process*> top;
+    std::vector<std::string> frame;
+    std::vector<std::string> previousFrame; // what the terminal shows
+    std::string output;
+
+    std::atomic<bool> running;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+};
@@ -0,0 +1,285 @@
+#include "Program.h"
+#include "Interpreter.h"
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+constexpr uint16_t Program::kMaxVariables;
+constexpr uint32_t Program::kSymbolTableSize;
+constexpr int Program::kMaxLoopDepth;
+
+Program::Program()
+    : dynamicLength(0) {}
+
+Operand Program::variable(const std::string& name) {
+    Operand operand;
+    operand.isVariable = true;
+
+    auto it = variableSlots.find(name);
+    if (it != variableSlots.end()) {
+        operand.value = it->second;
+    }
+    else if (variableNames.size() < kMaxVariables) {
+        operand.value = static_cast<uint16_t>(variableNames.size());
+        variableSlots[name] = operand.value;
+        variableNames.push_back(name);
+    }
+    else {
+        // Symbol table is full; the variable is ignored
+        operand.value = kMaxVariables;
+    }
+    return operand;
+}
+
+Operand Program::literal(uint16_t value) {
+    Operand operand;
+    operand.value = value;
+    operand.isVariable = false;
+    return operand;
+}
+
+void Program::appendPrint(const std::string& message) {
+    Instruction ins;
+    ins.op = OpCode::Print;
+    ins.arg = internMessage(message);
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendPrint(const std::string& message, const Operand& value) {
+    Instruction ins;
+    ins.op = OpCode::Print;
+    ins.arg = internMessage(message);
+    ins.lhs = value;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendDeclare(const std::string& name, uint16_t value) {
+    Instruction ins;
+    ins.op = OpCode::Declare;
+    ins.target = variable(name).value;
+    ins.lhs = literal(value);
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendAdd(const std::string& target, const Operand& lhs, const Operand& rhs) {
+    Instruction ins;
+    ins.op = OpCode::Add;
+    ins.target = variable(target).value;
+    ins.lhs = lhs;
+    ins.rhs = rhs;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendSubtract(const std::string& target, const Operand& lhs, const Operand& rhs) {
+    Instruction ins;
+    ins.op = OpCode::Subtract;
+    ins.target = variable(target).value;
+    ins.lhs = lhs;
+    ins.rhs = rhs;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendRead(const std::string& target, uint32_t address) {
+    Instruction ins;
+    ins.op = OpCode::Read;
+    ins.target = variable(target).value;
+    ins.arg = address & ~1u;    // 16-bit words are kept aligned
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendWrite(uint32_t address, const Operand& value) {
+    Instruction ins;
+    ins.op = OpCode::Write;
+    ins.arg = address & ~1u;
+    ins.lhs = value;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendSleep(uint32_t ticks) {
+    Instruction ins;
+    ins.op = OpCode::Sleep;
+    ins.arg = ticks;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::appendFork() {
+    Instruction ins;
+    ins.op = OpCode::Fork;
+    append(ins);
+    addCountedLines(1);
+}
+
+void Program::beginFor(uint32_t repeats) {
+    if (openLoops.size() >= static_cast<size_t>(kMaxLoopDepth)) {
+        throw std::length_error("FOR loops nested too deeply");
+    }
+
+    Instruction ins;
+    ins.op = OpCode::ForBegin;
+    ins.arg = repeats;
+    openLoops.push_back({ size(), repeats, 0 });
+    append(ins);
+}
+
+void Program::endFor() {
+    if (openLoops.empty()) {
+        throw std::logic_error("endFor without matching beginFor");
+    }
+
+    OpenLoop loop = openLoops.back();
+    openLoops.pop_back();
+
+    Instruction ins;
+    ins.op = OpCode::ForEnd;
+    ins.arg = loop.repeats;
+    ins.jump = loop.beginIndex;
+    code[loop.beginIndex].jump = size();
+    append(ins);
+
+    addCountedLines(loop.bodyLength * loop.repeats);
+}
+
+void Program::optimize() {
+    // Start from the plain handlers so the pass can be rerun after appends
+    for (Instruction& ins : code) {
+        ins.handler = Interpreter::specializedHandlerFor(ins);
+        ins.lines = Interpreter::isCountedLine(ins.op) ? 1 : 0;
+    }
+
+    // Loops whose body is straight-line code are replayed as one unit
+    for (uint32_t i = 0; i < size(); ++i) {
+        Instruction& ins = code[i];
+        if (ins.op != OpCode::ForBegin) continue;
+
+        bool straightLine = true;
+        for (uint32_t j = i + 1; j < ins.jump && straightLine; ++j) {
+            straightLine = Interpreter::isStraightLine(code[j].op);
+        }
+        uint64_t loopLines = uint64_t(ins.jump - i - 1) * ins.arg;
+        if (straightLine && loopLines <= UINT32_MAX) {
+            ins.handler = Interpreter::cachedLoopHandler();
+            ins.lines = static_cast<uint32_t>(loopLines);
+        }
+    }
+
+    // Greedily pair adjacent straight-line instructions. Loop markers are
+    // never fused, so a jump can never land in the middle of a pair.
+    for (uint32_t i = 0; i + 1 < size(); ) {
+        InstructionHandler fused = Interpreter::fusedHandlerFor(code[i].op, code[i + 1].op);
+        if (fused != nullptr) {
+            code[i].handler = fused;
+            code[i].lines = 2;
+            i += 2;
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+uint32_t Program::size() const {
+    return static_cast<uint32_t>(code.size());
+}
+
+const Instruction* Program::data() const {
+    return code.data();
+}
+
+const Instruction& Program::at(uint32_t index) const {
+    return code[index];
+}
+
+uint64_t Program::getDynamicLength() const {
+    return dynamicLength;
+}
+
+const std::string& Program::getMessage(uint32_t id) const {
+    return messages[id];
+}
+
+const std::string& Program::getVariableName(uint16_t slot) const {
+    static const std::string overflow = "<overflow>";
+    return slot < variableNames.size() ? variableNames[slot] : overflow;
+}
+
+uint16_t Program::getVariableCount() const {
+    return static_cast<uint16_t>(variableNames.size());
+}
+
+std::string Program::describe(uint32_t index) const {
+    if (index >= code.size()) {
+        return "";
+    }
+
+    const Instruction& ins = code[index];
+    switch (ins.op) {
+    case OpCode::Print:
+        if (ins.lhs.isVariable) {
+            return "PRINT(\"" + messages[ins.arg] + "\" + " + getVariableName(ins.lhs.value) + ")";
+        }
+        return "PRINT(\"" + messages[ins.arg] + "\")";
+    case OpCode::Declare:
+        return "DECLARE(" + getVariableName(ins.target) + ", " + std::to_string(ins.lhs.value) + ")";
+    case OpCode::Add:
+        return "ADD(" + getVariableName(ins.target) + ", " + describeOperand(ins.lhs) + ", " + describeOperand(ins.rhs) + ")";
+    case OpCode::Subtract:
+        return "SUBTRACT(" + getVariableName(ins.target) + ", " + describeOperand(ins.lhs) + ", " + describeOperand(ins.rhs) + ")";
+    case OpCode::Read:
+        return "READ(" + getVariableName(ins.target) + ", " + formatAddress(ins.arg) + ")";
+    case OpCode::Write:
+        return "WRITE(" + formatAddress(ins.arg) + ", " + describeOperand(ins.lhs) + ")";
+    case OpCode::Sleep:
+        return "SLEEP(" + std::to_string(ins.arg) + ")";
+    case OpCode::ForBegin:
+        return "FOR(" + std::to_string(ins.arg) + ") {";
+    case OpCode::ForEnd:
+        return "}";
+    case OpCode::Fork:
+        return "FORK()";
+    }
+    return "";
+}
+
+uint32_t Program::internMessage(const std::string& message) {
+    auto it = messageIds.find(message);
+    if (it != messageIds.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(messages.size());
+    messages.push_back(message);
+    messageIds[message] = id;
+    return id;
+}
+
+void Program::append(const Instruction& ins) {
+    code.push_back(ins);
+    code.back().handler = Interpreter::handlerFor(ins.op);
+    code.back().lines = Interpreter::isCountedLine(ins.op) ? 1 : 0;
+}
+
+void Program::addCountedLines(uint64_t lines) {
+    if (openLoops.empty()) {
+        dynamicLength += lines;
+    }
+    else {
+        openLoops.back().bodyLength += lines;
+    }
+}
+
+std::string Program::formatAddress(uint32_t address) {
+    std::ostringstream oss;
+    oss << "0x" << std::uppercase << std::hex << address;
+    return oss.str();
+}
+
+std::string Program::describeOperand(const Operand& operand) const {
+    return operand.isVariable ? getVariableName(operand.value) : std::to_string(operand.value);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Instruction.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A process's pre-decoded instruction stream. FOR loops are stored once
+// between ForBegin/ForEnd markers and replayed by the interpreter, so loop
+// bodies are never copied.
+class Program {
+public:
+    static constexpr uint16_t kMaxVariables = 32;
+    static constexpr uint32_t kSymbolTableSize = kMaxVariables * 2;
+    static constexpr int kMaxLoopDepth = 8;
+
+    Program();
+
+    Operand variable(const std::string& name);
+    static Operand literal(uint16_t value);
+
+    void appendPrint(const std::string& message);
+    void appendPrint(const std::string& message, const Operand& value);
+    void appendDeclare(const std::string& name, uint16_t value);
+    void appendAdd(const std::string& target, const Operand& lhs, const Operand& rhs);
+    void appendSubtract(const std::string& target, const Operand& lhs, const Operand& rhs);
+    void appendRead(const std::string& target, uint32_t address);
+    void appendWrite(uint32_t address, const Operand& value);
+    void appendSleep(uint32_t ticks);
+    void appendFork();      // the clone resumes after the FORK line
+    void beginFor(uint32_t repeats);
+    void endFor();
+
+    // Pre-pass that fuses adjacent instructions into superinstructions and
+    // caches straight-line FOR bodies. Only affects Interpreter::run; single
+    // stepping still retires one line at a time.
+    void optimize();
+
+    uint32_t size() const;
+    const Instruction* data() const;
+    const Instruction& at(uint32_t index) const;
+
+    // Number of instruction lines executed by a full run, loop repetitions included
+    uint64_t getDynamicLength() const;
+
+    const std::string& getMessage(uint32_t id) const;
+    const std::string& getVariableName(uint16_t slot) const;
+    uint16_t getVariableCount() const;
+    std::string describe(uint32_t index) const;
+
+    static std::string formatAddress(uint32_t address);
+
+private:
+    struct OpenLoop {
+        uint32_t beginIndex;
+        uint32_t repeats;
+        uint64_t bodyLength;
+    };
+
+    uint32_t internMessage(const std::string& message);
+    void append(const Instruction& ins);
+    void addCountedLines(uint64_t lines);
+    std::string describeOperand(const Operand& operand) const;
+
+    std::vector<Instruction> code;
+    std::vector<std::string> messages;
+    std::unordered_map<std::string, uint32_t> messageIds;
+    std::vector<std::string> variableNames;
+    std::unordered_map<std::string, uint16_t> variableSlots;
+    std::vector<OpenLoop> openLoops;
+    uint64_t dynamicLength;
+};
@@ -0,0 +1,279 @@
+#include "ReplacementPolicy.h"
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Doubly linked lists threaded through per-frame link arrays. A frame is
+// on at most one list; moving it or unlinking it never allocates. The
+// arrays grow to the highest frame loaded so far, not the configured
+// number of frames.
+class FrameLists {
+public:
+    struct List {
+        int head = -1;      // least recently inserted
+        int tail = -1;
+        size_t size = 0;
+    };
+
+    // Makes room for frame and returns the number of frames now covered
+    size_t cover(int frame) {
+        if (static_cast<size_t>(frame) >= next.size()) {
+            size_t size = std::max<size_t>(static_cast<size_t>(frame) + 1, next.size() * 2);
+            next.resize(size, -1);
+            prev.resize(size, -1);
+        }
+        return next.size();
+    }
+
+    void pushBack(List& list, int frame) {
+        cover(frame);
+        prev[frame] = list.tail;
+        next[frame] = -1;
+        if (list.tail >= 0) {
+            next[list.tail] = frame;
+        }
+        else {
+            list.head = frame;
+        }
+        list.tail = frame;
+        list.size++;
+    }
+
+    void remove(List& list, int frame) {
+        if (prev[frame] >= 0) next[prev[frame]] = next[frame];
+        else list.head = next[frame];
+        if (next[frame] >= 0) prev[next[frame]] = prev[frame];
+        else list.tail = prev[frame];
+        list.size--;
+    }
+
+    int popFront(List& list) {
+        int frame = list.head;
+        if (frame >= 0) {
+            remove(list, frame);
+        }
+        return frame;
+    }
+
+    int following(int frame) const {
+        return next[frame];
+    }
+
+private:
+    std::vector<int> next;
+    std::vector<int> prev;
+};
+
+class FifoPolicy : public ReplacementPolicy {
+public:
+
+    const char* getName() const override { return "fifo"; }
+    void onLoad(int frame, uint64_t) override { links.pushBack(resident, frame); }
+    void onAccess(int) override {}
+    void onRemove(int frame) override { links.remove(resident, frame); }
+    int chooseVictim(uint64_t) override { return links.popFront(resident); }
+
+private:
+    FrameLists links;
+    FrameLists::List resident;      // in page-in order
+};
+
+class LruPolicy : public ReplacementPolicy {
+public:
+
+    const char* getName() const override { return "lru"; }
+    void onLoad(int frame, uint64_t) override { links.pushBack(resident, frame); }
+
+    void onAccess(int frame) override {
+        links.remove(resident, frame);
+        links.pushBack(resident, frame);
+    }
+
+    void onRemove(int frame) override { links.remove(resident, frame); }
+    int chooseVictim(uint64_t) override { return links.popFront(resident); }
+
+private:
+    FrameLists links;
+    FrameLists::List resident;      // least recently used first
+};
+
+// Second chance: the hand sweeps the resident frames in load order,
+// clearing reference bits, and evicts the first frame found unreferenced
+class ClockPolicy : public ReplacementPolicy {
+public:
+    ClockPolicy() : hand(-1) {}
+
+    const char* getName() const override { return "clock"; }
+
+    void onLoad(int frame, uint64_t) override {
+        referenced.resize(links.cover(frame), false);
+        links.pushBack(resident, frame);
+        referenced[frame] = false;
+    }
+
+    void onAccess(int frame) override { referenced[frame] = true; }
+
+    void onRemove(int frame) override {
+        if (frame == hand) {
+            advance();
+        }
+        links.remove(resident, frame);
+        if (resident.size == 0) {
+            hand = -1;
+        }
+    }
+
+    int chooseVictim(uint64_t) override {
+        if (resident.size == 0) {
+            return -1;
+        }
+        if (hand < 0) {
+            hand = resident.head;
+        }
+        while (referenced[hand]) {
+            referenced[hand] = false;
+            advance();
+        }
+        int victim = hand;
+        onRemove(victim);
+        return victim;
+    }
+
+private:
+    void advance() {
+        hand = links.following(hand);
+        if (hand < 0) {
+            hand = resident.head;
+        }
+    }
+
+    FrameLists links;
+    FrameLists::List resident;
+    std::vector<bool> referenced;
+    int hand;
+};
+
+// Adaptive Replacement Cache (Megiddo and Modha). T1 holds pages seen once
+// recently and T2 pages seen at least twice; B1 and B2 remember the keys
+// recently evicted from each. A miss that hits a ghost list shifts the
+// target size of T1 towards whichever list would have kept the page.
+class ArcPolicy : public ReplacementPolicy {
+public:
+    explicit ArcPolicy(size_t numFrames)
+        : capacity(numFrames), target(0) {}
+
+    const char* getName() const override { return "arc"; }
+
+    void onLoad(int frame, uint64_t key) override {
+        size_t covered = links.cover(frame);
+        keys.resize(covered, 0);
+        inT2.resize(covered, false);
+        keys[frame] = key;
+        auto ghost = ghosts.find(key);
+        if (ghost == ghosts.end()) {
+            links.pushBack(t1, frame);
+            inT2[frame] = false;
+        }
+        else {
+            bool fromB2 = ghost->second.inB2;
+            size_t b1 = b1Keys.size();
+            size_t b2 = b2Keys.size();
+            if (fromB2) {
+                size_t step = std::max<size_t>(b2 > 0 ? b1 / b2 : 1, 1);
+                target = target > step ? target - step : 0;
+                b2Keys.erase(ghost->second.position);
+            }
+            else {
+                size_t step = std::max<size_t>(b1 > 0 ? b2 / b1 : 1, 1);
+                target = std::min(capacity, target + step);
+                b1Keys.erase(ghost->second.position);
+            }
+            ghosts.erase(ghost);
+            links.pushBack(t2, frame);
+            inT2[frame] = true;
+        }
+        trimGhosts();
+    }
+
+    void onAccess(int frame) override {
+        links.remove(inT2[frame] ? t2 : t1, frame);
+        links.pushBack(t2, frame);
+        inT2[frame] = true;
+    }
+
+    void onRemove(int frame) override {
+        links.remove(inT2[frame] ? t2 : t1, frame);
+    }
+
+    int chooseVictim(uint64_t incomingKey) override {
+        if (t1.size == 0 && t2.size == 0) {
+            return -1;
+        }
+        auto ghost = ghosts.find(incomingKey);
+        bool incomingInB2 = ghost != ghosts.end() && ghost->second.inB2;
+
+        int victim;
+        if (t1.size > 0 && (t1.size > target || (incomingInB2 && t1.size == target) || t2.size == 0)) {
+            victim = links.popFront(t1);
+            remember(b1Keys, keys[victim], false);
+        }
+        else {
+            victim = links.popFront(t2);
+            remember(b2Keys, keys[victim], true);
+        }
+        return victim;
+    }
+
+private:
+    struct Ghost {
+        std::list<uint64_t>::iterator position;
+        bool inB2;
+    };
+
+    void remember(std::list<uint64_t>& ghostList, uint64_t key, bool inB2) {
+        ghostList.push_back(key);
+        ghosts[key] = { std::prev(ghostList.end()), inB2 };
+    }
+
+    void forgetOldest(std::list<uint64_t>& ghostList) {
+        ghosts.erase(ghostList.front());
+        ghostList.pop_front();
+    }
+
+    // The directory holds at most capacity pages in T1 and B1 together,
+    // and at most twice capacity overall
+    void trimGhosts() {
+        while (!b1Keys.empty() && t1.size + b1Keys.size() > capacity) {
+            forgetOldest(b1Keys);
+        }
+        while (!b2Keys.empty() && t1.size + t2.size + b1Keys.size() + b2Keys.size() > 2 * capacity) {
+            forgetOldest(b2Keys);
+        }
+    }
+
+    FrameLists links;
+    FrameLists::List t1;
+    FrameLists::List t2;
+    std::vector<uint64_t> keys;         // page held by each frame
+    std::vector<bool> inT2;
+
+    std::list<uint64_t> b1Keys;         // oldest first
+    std::list<uint64_t> b2Keys;
+    std::unordered_map<uint64_t, Ghost> ghosts;
+
+    size_t capacity;
+    size_t target;                      // preferred size of T1
+};
+
+} // namespace
+
+std::unique_ptr<ReplacementPolicy> ReplacementPolicy::create(const std::string& name, size_t numFrames) {
+    if (name == "fifo") return std::unique_ptr<ReplacementPolicy>(new FifoPolicy());
+    if (name == "lru") return std::unique_ptr<ReplacementPolicy>(new LruPolicy());
+    if (name == "clock") return std::unique_ptr<ReplacementPolicy>(new ClockPolicy());
+    if (name == "arc") return std::unique_ptr<ReplacementPolicy>(new ArcPolicy(numFrames));
+    return nullptr;
+}
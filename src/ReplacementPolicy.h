@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Chooses which resident page to evict when paging runs out of frames.
+// Policies track frames by number; pages are identified by a key that is
+// stable across evictions (process ID and page number), which ARC uses to
+// recognise pages it evicted recently. Every operation is O(1), or
+// amortized O(1) for CLOCK.
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() = default;
+
+    // Builds the policy named fifo, lru, clock or arc; nullptr for any other name
+    static std::unique_ptr<ReplacementPolicy> create(const std::string& name, size_t numFrames);
+
+    static uint64_t pageKey(int processId, unsigned int page) {
+        return (uint64_t(uint32_t(processId)) << 32) | page;
+    }
+
+    virtual const char* getName() const = 0;
+
+    virtual void onLoad(int frame, uint64_t key) = 0;   // key became resident in frame
+    virtual void onAccess(int frame) = 0;               // the resident page was referenced
+    virtual void onRemove(int frame) = 0;               // freed without eviction
+
+    // Removes the page to evict to make room for incomingKey and returns
+    // its frame, or -1 if nothing is resident
+    virtual int chooseVictim(uint64_t incomingKey) = 0;
+};
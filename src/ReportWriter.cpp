@@ -0,0 +1,261 @@
+#include "ReportWriter.h"
+#include "ConsoleManager.h"
+#include "Process.h"
+#include "ProcessArchive.h"
+#include "Scheduler.h"
+#include <cstdio>
+#include <iostream>
+
+constexpr size_t ReportWriter::kBufferSize;
+constexpr size_t ReportWriter::kTimeCacheSize;
+
+ReportWriter::ReportWriter(ConsoleManager& consoleManager, const std::string& filename)
+    : consoleManager(consoleManager), filename(filename), archiveCursor(0), reportNumber(0), busy(false) {}
+
+ReportWriter::~ReportWriter() {
+    wait();
+}
+
+bool ReportWriter::write(bool incremental, bool background) {
+    if (busy.load()) {
+        return false;
+    }
+    wait();
+
+    if (!background) {
+        if (writeReport(incremental)) {
+            std::cout << "Utilization report saved to " << filename << ".\n";
+        }
+        else {
+            std::cout << "Failed to open " << filename << " for writing.\n";
+        }
+        return true;
+    }
+
+    busy.store(true);
+    backgroundThread = std::thread([this, incremental]() {
+        bool saved = writeReport(incremental);
+        consoleManager.safePrint(saved
+            ? "Utilization report saved to " + filename + "."
+            : "Failed to open " + filename + " for writing.");
+        busy.store(false);
+    });
+    return true;
+}
+
+void ReportWriter::wait() {
+    if (backgroundThread.joinable()) {
+        backgroundThread.join();
+    }
+}
+
+const std::string& ReportWriter::getFilename() const {
+    return filename;
+}
+
+bool ReportWriter::writeReport(bool incremental) {
+    ConsoleManager::ProcessHold hold(consoleManager);
+    Scheduler* scheduler = consoleManager.getScheduler();
+    file.open(filename, std::ios::app);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (buffer.capacity() < kBufferSize) {
+        buffer.reserve(kBufferSize);
+    }
+    buffer.clear();
+    reportNumber++;
+
+    std::time_t now = std::time(nullptr);
+    char generatedAt[26];
+    ctime_s(generatedAt, sizeof(generatedAt), &now);
+    buffer += "Report generated at: ";
+    buffer += generatedAt;
+    buffer += "\n";
+    if (incremental) {
+        buffer += "Incremental report: only processes that changed since the previous report.\n";
+    }
+
+    // Display CPU utilization and core information
+    int totalCores = scheduler->getTotalCores();
+    int busyCores = scheduler->getBusyCores();
+    char utilization[32];
+    std::snprintf(utilization, sizeof(utilization), "%.2f", (double)busyCores / totalCores * 100.0);
+    buffer += "CPU utilization: ";
+    buffer += utilization;
+    buffer += "%\nCores used: ";
+    appendInt(busyCores);
+    buffer += "\nCores available: ";
+    appendInt(totalCores - busyCores);
+    buffer += "\n\n-------------------------------------------------------";
+
+    // Queued processes. Only the pointers are taken under the queue lock,
+    // so workers are not held up while the lines are formatted.
+    queued.clear();
+    scheduler->forEachQueuedProcess([this](Process* process) {
+        queued.emplace_back(process->getId(), process);
+    });
+    bool started = false;
+    for (const auto& entry : queued) {
+        Process* process = entry.second;
+        int line = process->getCurrentLine();
+        if (!track(entry.first, ReportedState::Queued, line, incremental)) continue;
+        beginSection(started, "\nQueued processes:\n");
+        appendLine(process->getName(), process->getCreationTime(), "Queued     ", -1, line, process->getTotalLines());
+    }
+    endSection(started, "\nNo queued processes", incremental);
+    flushIfFull();
+
+    // Running processes; one per core at most, so the copy is cheap
+    started = false;
+    for (const auto& pair : scheduler->getRunningProcesses()) {
+        Process* process = pair.first;
+        int line = process->getCurrentLine();
+        if (!track(process->getId(), ReportedState::Running, line, incremental)) continue;
+        beginSection(started, "\nRunning processes:\n");
+        appendLine(process->getName(), process->getCreationTime(), nullptr, pair.second, line, process->getTotalLines());
+    }
+    endSection(started, "\nNo running processes", incremental);
+
+    // Finished processes still in the process table
+    started = false;
+    scheduler->forEachFinishedProcess([&](Process* process) {
+        if (!track(process->getId(), ReportedState::Finished, process->getCurrentLine(), incremental)) return;
+        int totalLines = process->getTotalLines();
+        beginSection(started, "\nFinished processes:\n");
+        appendLine(process->getName(), process->getCreationTime(), "Finished     ", -1, totalLines, totalLines);
+    });
+    endSection(started, "\nNo finished processes", incremental);
+    flushIfFull();
+
+    // Processes retired from the process table. The archive only grows, so
+    // an incremental report starts where the previous one stopped, and
+    // skips processes the previous report already showed as finished.
+    started = false;
+    size_t fromIndex = incremental ? archiveCursor : 0;
+    archiveCursor = consoleManager.getProcessArchive().forEachSummary(fromIndex, [&](const ProcessSummary& summary) {
+        if (incremental) {
+            auto it = reported.find(summary.id);
+            if (it != reported.end() && it->second.state == ReportedState::Finished
+                && it->second.line == summary.executedLines) {
+                reported.erase(it);
+                return;
+            }
+        }
+        if (!started) {
+            buffer += "\nArchived processes:\n";
+            started = true;
+        }
+        appendLine(summary.name, summary.creationTime, summary.accessViolation ? "Terminated   " : "Finished     ",
+            -1, summary.executedLines, summary.totalLines);
+        flushIfFull();
+    });
+
+    // Forget processes that have left the process table
+    for (auto it = reported.begin(); it != reported.end(); ) {
+        if (it->second.report != reportNumber) {
+            it = reported.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    buffer += "-------------------------------------------------------\n\n\n";
+    flush();
+    file.close();
+    return true;
+}
+
+bool ReportWriter::track(int processId, ReportedState state, int line, bool incremental) {
+    auto it = reported.find(processId);
+    if (it == reported.end()) {
+        reported.emplace(processId, Reported{ state, line, reportNumber });
+        return true;
+    }
+    bool changed = it->second.state != state || it->second.line != line;
+    it->second = Reported{ state, line, reportNumber };
+    return changed || !incremental;
+}
+
+void ReportWriter::beginSection(bool& started, const char* heading) {
+    if (!started) {
+        buffer += heading;
+        started = true;
+    }
+}
+
+void ReportWriter::endSection(bool started, const char* none, bool incremental) {
+    if (started) {
+        return;
+    }
+    buffer += none;
+    if (incremental) {
+        buffer += " changed since the previous report";
+    }
+    buffer += ".\n";
+}
+
+void ReportWriter::appendLine(const std::string& name, std::time_t creationTime, const char* status, int coreId, int line, int totalLines) {
+    // Format: processName  (creationTime)  status   line / totalLines
+    buffer += name;
+    if (name.size() < 15) {
+        buffer.append(15 - name.size(), ' ');
+    }
+    buffer += '(';
+    appendTime(creationTime);
+    buffer += ")    ";
+    if (status != nullptr) {
+        buffer += status;
+    }
+    else {
+        buffer += "Core: ";
+        appendInt(coreId);
+        buffer += "     ";
+    }
+    appendInt(line);
+    buffer += " / ";
+    appendInt(totalLines);
+    buffer += '\n';
+}
+
+void ReportWriter::appendInt(long long value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ULL - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+    do {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) {
+        *--p = '-';
+    }
+    buffer.append(p, end);
+}
+
+void ReportWriter::appendTime(std::time_t time) {
+    CachedTime& cached = timeCache[static_cast<uint64_t>(time) % kTimeCacheSize];
+    if (cached.second != time) {
+        std::tm localTime;
+        localtime_s(&localTime, &time);
+        cached.length = std::strftime(cached.text, sizeof(cached.text), "%m/%d/%Y %I:%M:%S%p", &localTime);
+        cached.second = time;
+    }
+    buffer.append(cached.text, cached.length);
+}
+
+void ReportWriter::flushIfFull() {
+    if (buffer.size() >= kBufferSize) {
+        flush();
+    }
+}
+
+void ReportWriter::flush() {
+    if (!buffer.empty()) {
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    file.flush();
+}
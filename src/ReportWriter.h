@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ConsoleManager;
+class Process;
+
+// Writes report-util's utilization report. Process lines are formatted
+// straight into one large buffer while walking the scheduler's and the
+// archive's own indexes, so a report over hundreds of thousands of
+// processes copies no process lists and formats each creation second once.
+class ReportWriter {
+public:
+    static constexpr size_t kBufferSize = 1 << 20;
+
+    explicit ReportWriter(ConsoleManager& consoleManager, const std::string& filename = "csopesy-log.txt");
+    ~ReportWriter();
+
+    // An incremental report lists only the processes that changed since the
+    // previous report. A background report returns at once and announces
+    // itself when saved. Returns false if a background report is still
+    // being written.
+    bool write(bool incremental, bool background);
+    void wait();
+
+    const std::string& getFilename() const;
+
+private:
+    enum class ReportedState : uint8_t {
+        Queued,
+        Running,
+        Finished
+    };
+
+    // What the last report said about a process, keyed by PID
+    struct Reported {
+        ReportedState state;
+        int line;
+        uint64_t report;    // the last report that saw it live
+    };
+
+    struct CachedTime {
+        std::time_t second = -1;
+        char text[32];
+        size_t length = 0;
+    };
+
+    bool writeReport(bool incremental);
+
+    // Records the process as of this report; false when an incremental
+    // report can leave it out
+    bool track(int processId, ReportedState state, int line, bool incremental);
+
+    void beginSection(bool& started, const char* heading);
+    void endSection(bool started, const char* none, bool incremental);
+    void appendLine(const std::string& name, std::time_t creationTime, const char* status, int coreId, int line, int totalLines);
+    void appendInt(long long value);
+    void appendTime(std::time_t time);
+    void flushIfFull();
+    void flush();
+
+    ConsoleManager& consoleManager;
+    std::string filename;
+    std::ofstream file;
+    std::string buffer;
+
+    // Creation times cluster in the same few seconds; a small direct-mapped
+    // cache turns nearly every localtime_s and strftime into a lookup
+    static constexpr size_t kTimeCacheSize = 64;
+    CachedTime timeCache[kTimeCacheSize];
+
+    // Queued processes by PID, collected under the scheduler's queue lock
+    // and formatted once it is released; kept between reports
+    std::vector<std::pair<int, Process*>> queued;
+
+    std::unordered_map<int, Reported> reported;
+    size_t archiveCursor;
+    uint64_t reportNumber;
+
+    std::thread backgroundThread;
+    std::atomic<bool> busy;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <map>
 #include <vector>
 #include "Process.h"
@@ -10,6 +11,10 @@ class Scheduler {
 public:
     virtual ~Scheduler() = default;
     virtual void addProcess(Process* process) = 0;
+    // Queues a batch of new processes, taking each scheduler lock once
+    virtual void addProcesses(const std::vector<Process*>& processes) = 0;
+    // Forgets finished processes before they are freed
+    virtual void removeProcesses(const std::vector<Process*>& processes) = 0;
     virtual void start() = 0;
     virtual void stop() = 0;
     virtual void pause() = 0;
@@ -23,4 +28,10 @@ public:
     virtual std::map<Process*, int> getRunningProcesses() const = 0;
     virtual std::vector<Process*> getQueuedProcesses() const = 0;
     virtual std::vector<Process*> getFinishedProcesses() const = 0;
+
+    // Visit the same processes in place under the scheduler's lock, for
+    // reports over many processes. The visitor must not call back into the
+    // scheduler, and should not block.
+    virtual void forEachQueuedProcess(const std::function<void(Process*)>& visitor) const = 0;
+    virtual void forEachFinishedProcess(const std::function<void(Process*)>& visitor) const = 0;
 };
@@ -1,6 +1,7 @@
-#include "Command.h"
 #include "Config.h"
 #include "SchedulerFirstComeFirstServe.h"
+#include "Tlb.h"
+#include "Tracer.h"
 #include <algorithm>
 #include <iostream>
 #include <thread>
@@ -32,12 +33,44 @@ void SchedulerFirstComeFirstServe::addProcess(Process* process) {
 	}
 	{
 		std::lock_guard<std::mutex> lock(allProcessesMutex);
-		if (std::find(allProcesses.begin(), allProcesses.end(), process) == allProcesses.end()) {
+		if (allProcessesSet.insert(process).second) {
 			allProcesses.push_back(process);
 		}
 	}
 }
 
+void SchedulerFirstComeFirstServe::addProcesses(const std::vector<Process*>& processes) {
+	{
+		std::lock_guard<std::mutex> lock(allProcessesMutex);
+		allProcesses.reserve(allProcesses.size() + processes.size());
+		for (Process* process : processes) {
+			if (allProcessesSet.insert(process).second) {
+				allProcesses.push_back(process);
+			}
+		}
+	}
+
+	std::vector<Process*> newlyQueued;
+	newlyQueued.reserve(processes.size());
+	std::lock_guard<std::mutex> lock(queuedProcessesMutex);
+	for (Process* process : processes) {
+		if (queuedProcessesSet.insert(process).second) {
+			newlyQueued.push_back(process);
+		}
+	}
+	processQueue.push_all(newlyQueued.begin(), newlyQueued.end());
+}
+
+void SchedulerFirstComeFirstServe::removeProcesses(const std::vector<Process*>& processes) {
+	std::lock_guard<std::mutex> lock(allProcessesMutex);
+	for (Process* process : processes) {
+		allProcessesSet.erase(process);
+	}
+	allProcesses.erase(std::remove_if(allProcesses.begin(), allProcesses.end(), [this](Process* process) {
+		return allProcessesSet.find(process) == allProcessesSet.end();
+		}), allProcesses.end());
+}
+
 void SchedulerFirstComeFirstServe::start() {
 	if (running.load()) return;
 	running.store(true);
@@ -117,6 +150,13 @@ void SchedulerFirstComeFirstServe::schedulerLoop() {
 				}
 			}
 
+			// Start paging in the working set of the process due next, so
+			// its swap reads overlap with this one's run
+			Process* next = nullptr;
+			if (processQueue.try_peek(next)) {
+				consoleManager.getMemoryManager().prefetch(next);
+			}
+
 			// Assign process to an idle worker
 			bool assigned = false;
 			while (!assigned && running.load()) {
@@ -144,6 +184,7 @@ void SchedulerFirstComeFirstServe::workerLoop(int coreId) {
 	Worker* worker = workers[coreId];
 	Config& config = Config::getInstance();
 	unsigned int delayPerExec = config.getDelaysPerExec();
+	Tracer::setCurrentCore(coreId);
 
 	while (running.load()) {
 		// Pause handling
@@ -187,15 +228,19 @@ void SchedulerFirstComeFirstServe::workerLoop(int coreId) {
 			}
 		}
 
-		Command* cmd = nullptr;
-		while ((cmd = process->getNextCommand()) != nullptr && running.load()) {
+		Tracer::record(TraceEventType::Dispatch, process->getId());
+
+		bool requeued = false;
+		bool terminated = false;
+		while (running.load() && process->hasRemainingInstructions()) {
 			// Check memory status before each instruction
 			if (!process->isInMemory()) {
 				// Lost memory allocation, need to requeue
 				if (!consoleManager.getMemoryManager().allocateMemory(process, process->getMemorySize())) {
-					// Put command back and requeue process
-					process->addCommand(cmd);
+					// The program counter has not moved; requeue the process as is
+					Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Memory));
 					addProcess(process);
+					requeued = true;
 
 					// Reset worker state
 					lock.lock();
@@ -216,15 +261,85 @@ void SchedulerFirstComeFirstServe::workerLoop(int coreId) {
 			}
 			if (!running.load()) break;
 
+			// Execute instruction
+			Interpreter::StepResult result = process->executeNextInstruction(coreId);
+			if (result == Interpreter::StepResult::Finished) {
+				break;
+			}
+			if (result == Interpreter::StepResult::Sleeping) {
+				// The process gives up the core while it sleeps and is requeued
+				// when it wakes; none of its sleep counts as active CPU time
+				unsigned int ticks = 1 + process->takeSleepTicks();
+				process->log("Process sleeping for " + std::to_string(ticks) + " ticks.", coreId);
+				Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Sleep));
+				consoleManager.sleepProcess(process, ticks);
+				requeued = true;
+
+				lock.lock();
+				worker->busy.store(false);
+				worker->currentProcess = nullptr;
+				lock.unlock();
+
+				break;
+			}
+			if (result == Interpreter::StepResult::AccessViolation) {
+				process->setCompleted(true);
+				process->log("Process shut down due to memory access violation.", coreId);
+				Tracer::record(TraceEventType::Complete, process->getId(), 1);
+				consoleManager.getMemoryManager().deallocateMemory(process);
+				terminated = true;
+				break;
+			}
+			if (result == Interpreter::StepResult::Forked) {
+				// The child resumes after the FORK line and queues like any new process
+				Process* child = consoleManager.forkProcess(process);
+				if (child) {
+					process->log("Forked process " + child->getName() + ".", coreId);
+				}
+				else {
+					process->log("Fork failed.", coreId);
+				}
+			}
+			if (result == Interpreter::StepResult::PageFault) {
+				// Servicing the fault costs this tick; the instruction is retried next tick
+				FaultResult fault = consoleManager.getMemoryManager().handlePageFault(process, process->getFaultAddress());
+				if (fault == FaultResult::Blocked) {
+					// Only this process waits for the swap read; the page-in
+					// handler requeues it
+					process->log("Process blocked on page-in.", coreId);
+					Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::PageWait));
+					requeued = true;
+
+					lock.lock();
+					worker->busy.store(false);
+					worker->currentProcess = nullptr;
+					lock.unlock();
+
+					break;
+				}
+				if (fault == FaultResult::Failed) {
+					Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Memory));
+					addProcess(process);
+					requeued = true;
+
+					lock.lock();
+					worker->busy.store(false);
+					worker->currentProcess = nullptr;
+					lock.unlock();
+
+					break;
+				}
+			}
+
 			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			cpuCycles++;
-			consoleManager.getMemoryManager().incrementActiveCpuTicks();
-
-			// Execute instruction
-			cmd->execute(process, coreId);
-			delete cmd;
+			consoleManager.getMemoryManager().incrementActiveCpuTicks(process);
 
-			process->incrementCurrentLine();
+			// Page-table walks for this instruction's TLB misses stall the core
+			for (uint32_t stall = Tlb::takeStallCycles(coreId); stall > 0; --stall) {
+				cpuCycles++;
+				consoleManager.getMemoryManager().incrementActiveCpuTicks();
+			}
 
 			// Simulate delay-per-exec
 			for (unsigned int i = 0; i < delayPerExec; ++i) {
@@ -236,9 +351,10 @@ void SchedulerFirstComeFirstServe::workerLoop(int coreId) {
 		if (!running.load()) break;
 
 		// Only deallocate memory and mark process as completed if we finished all instructions
-		if (process->getNextCommand() == nullptr) {
+		if (!requeued && !terminated && !process->hasRemainingInstructions()) {
 			process->setCompleted(true);
 			process->log("Process finished execution.", coreId);
+			Tracer::record(TraceEventType::Complete, process->getId());
 			consoleManager.getMemoryManager().deallocateMemory(process);
 		}
 
@@ -256,7 +372,8 @@ int SchedulerFirstComeFirstServe::getTotalCores() const {
 int SchedulerFirstComeFirstServe::getBusyCores() const {
 	int busyCores = 0;
 	for (const Worker* worker : workers) {
-		if (worker->busy.load() && worker->currentProcess != nullptr && worker->currentProcess->isInMemory()) {
+		Process* process = worker->currentProcess.load();
+		if (worker->busy.load() && process != nullptr && process->isInMemory()) {
 			busyCores++;
 		}
 	}
@@ -266,8 +383,9 @@ int SchedulerFirstComeFirstServe::getBusyCores() const {
 std::map<Process*, int> SchedulerFirstComeFirstServe::getRunningProcesses() const {
 	std::map<Process*, int> runningProcesses;
 	for (const Worker* worker : workers) {
-		if (worker->currentProcess != nullptr && worker->currentProcess->isInMemory()) {
-			runningProcesses[worker->currentProcess] = worker->coreId;
+		Process* process = worker->currentProcess.load();
+		if (process != nullptr && process->isInMemory()) {
+			runningProcesses[process] = worker->coreId;
 		}
 	}
 	return runningProcesses;
@@ -275,23 +393,41 @@ std::map<Process*, int> SchedulerFirstComeFirstServe::getRunningProcesses() cons
 
 std::vector<Process*> SchedulerFirstComeFirstServe::getQueuedProcesses() const {
 	std::vector<Process*> queuedProcesses;
-	{
-		std::lock_guard<std::mutex> lock(queuedProcessesMutex);
-		for (auto process : queuedProcessesSet) {
-			queuedProcesses.push_back(process);
-		}
-	}
+	forEachQueuedProcess([&queuedProcesses](Process* process) {
+		queuedProcesses.push_back(process);
+		});
 	return queuedProcesses;
 }
 
 std::vector<Process*> SchedulerFirstComeFirstServe::getFinishedProcesses() const {
 	std::vector<Process*> finishedProcesses;
+	forEachFinishedProcess([&finishedProcesses](Process* process) {
+		finishedProcesses.push_back(process);
+		});
+	return finishedProcesses;
+}
+
+void SchedulerFirstComeFirstServe::forEachQueuedProcess(const std::function<void(Process*)>& visitor) const {
+	std::lock_guard<std::mutex> lock(queuedProcessesMutex);
+	for (Process* process : queuedProcessesSet) {
+		visitor(process);
+	}
+}
+
+void SchedulerFirstComeFirstServe::forEachFinishedProcess(const std::function<void(Process*)>& visitor) const {
+	std::vector<Process*> runningProcesses;
+	for (const Worker* worker : workers) {
+		Process* process = worker->currentProcess.load();
+		if (process != nullptr && process->isInMemory()) {
+			runningProcesses.push_back(process);
+		}
+	}
+
 	std::lock_guard<std::mutex> lock(allProcessesMutex);
-	auto runningProcesses = getRunningProcesses();
 	for (Process* process : allProcesses) {
-		if (process->isCompleted() && runningProcesses.find(process) == runningProcesses.end()) {
-			finishedProcesses.push_back(process);
+		if (process->isCompleted()
+			&& std::find(runningProcesses.begin(), runningProcesses.end(), process) == runningProcesses.end()) {
+			visitor(process);
 		}
 	}
-	return finishedProcesses;
 }
\ No newline at end of file
@@ -17,6 +17,8 @@ public:
 	~SchedulerFirstComeFirstServe();
 
 	void addProcess(Process* process) override;
+	void addProcesses(const std::vector<Process*>& processes) override;
+	void removeProcesses(const std::vector<Process*>& processes) override;
 	void start() override;
 	void stop() override;
 	void pause() override;
@@ -30,6 +32,8 @@ public:
 	std::map<Process*, int> getRunningProcesses() const override;
 	std::vector<Process*> getQueuedProcesses() const override;
 	std::vector<Process*> getFinishedProcesses() const override;
+	void forEachQueuedProcess(const std::function<void(Process*)>& visitor) const override;
+	void forEachFinishedProcess(const std::function<void(Process*)>& visitor) const override;
 
 private:
 	void schedulerLoop();
@@ -49,7 +53,7 @@ private:
 	struct Worker {
 		int coreId = 0;
 		std::atomic<bool> busy{ false };
-		Process* currentProcess = nullptr;
+		std::atomic<Process*> currentProcess{ nullptr };    // read by monitors without locking
 		std::thread thread;
 		std::mutex mtx;
 		std::condition_variable cv;
@@ -60,6 +64,7 @@ private:
 	ConsoleManager& consoleManager;
 
 	std::vector<Process*> allProcesses;
+	std::unordered_set<Process*> allProcessesSet;
 	mutable std::mutex allProcessesMutex;
 
 	std::unordered_set<Process*> queuedProcessesSet;
@@ -1,6 +1,7 @@
-#include "Command.h"
 #include "Config.h"
 #include "SchedulerRoundRobin.h"
+#include "Tlb.h"
+#include "Tracer.h"
 #include <algorithm>
 #include <iostream>
 #include <thread>
@@ -32,12 +33,44 @@ void SchedulerRoundRobin::addProcess(Process* process) {
 	}
 	{
 		std::lock_guard<std::mutex> lock(allProcessesMutex);
-		if (std::find(allProcesses.begin(), allProcesses.end(), process) == allProcesses.end()) {
+		if (allProcessesSet.insert(process).second) {
 			allProcesses.push_back(process);
 		}
 	}
 }
 
+void SchedulerRoundRobin::addProcesses(const std::vector<Process*>& processes) {
+	{
+		std::lock_guard<std::mutex> lock(allProcessesMutex);
+		allProcesses.reserve(allProcesses.size() + processes.size());
+		for (Process* process : processes) {
+			if (allProcessesSet.insert(process).second) {
+				allProcesses.push_back(process);
+			}
+		}
+	}
+
+	std::vector<Process*> newlyQueued;
+	newlyQueued.reserve(processes.size());
+	std::lock_guard<std::mutex> lock(queuedProcessesMutex);
+	for (Process* process : processes) {
+		if (queuedProcessesSet.insert(process).second) {
+			newlyQueued.push_back(process);
+		}
+	}
+	processQueue.push_all(newlyQueued.begin(), newlyQueued.end());
+}
+
+void SchedulerRoundRobin::removeProcesses(const std::vector<Process*>& processes) {
+	std::lock_guard<std::mutex> lock(allProcessesMutex);
+	for (Process* process : processes) {
+		allProcessesSet.erase(process);
+	}
+	allProcesses.erase(std::remove_if(allProcesses.begin(), allProcesses.end(), [this](Process* process) {
+		return allProcessesSet.find(process) == allProcessesSet.end();
+		}), allProcesses.end());
+}
+
 void SchedulerRoundRobin::start() {
 	if (running.load()) return;
 	running.store(true);
@@ -117,6 +150,13 @@ void SchedulerRoundRobin::schedulerLoop() {
 				}
 			}
 
+			// Start paging in the working set of the process due next, so
+			// its swap reads overlap with this one's run
+			Process* next = nullptr;
+			if (processQueue.try_peek(next)) {
+				consoleManager.getMemoryManager().prefetch(next);
+			}
+
 			// Assign process to an idle worker
 			bool assigned = false;
 			while (!assigned && running.load()) {
@@ -145,6 +185,7 @@ void SchedulerRoundRobin::workerLoop(int coreId) {
 	Worker* worker = workers[coreId];
 	Config& config = Config::getInstance();
 	unsigned int delayPerExec = config.getDelaysPerExec();
+	Tracer::setCurrentCore(coreId);
 
 	while (running.load()) {
 		// Pause handling
@@ -191,8 +232,10 @@ void SchedulerRoundRobin::workerLoop(int coreId) {
 			}
 		}
 
+		Tracer::record(TraceEventType::Dispatch, process->getId());
+
 		bool processCompleted = false;
-		Command* lastCommand = nullptr;
+		bool blocked = false;
 
 		while (timeSlice > 0 && running.load()) {
 			// Pause handling
@@ -207,12 +250,10 @@ void SchedulerRoundRobin::workerLoop(int coreId) {
 			// Verify memory status before executing next instruction
 			if (!process->isInMemory()) {
 				if (!consoleManager.getMemoryManager().allocateMemory(process, process->getMemorySize())) {
-					// Lost memory allocation during execution, need to requeue
+					// Lost memory allocation during execution, need to requeue.
+					// The program counter has not moved, so nothing is lost.
 					process->log("Process lost memory allocation, requeueing.", coreId);
-					if (lastCommand != nullptr) {
-						// Re-add the last command that couldn't be executed
-						process->addCommand(lastCommand);
-					}
+					Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Memory));
 					addProcess(process);
 
 					// Reset worker state
@@ -226,28 +267,72 @@ void SchedulerRoundRobin::workerLoop(int coreId) {
 				}
 			}
 
-			Command* cmd = process->getNextCommand();
-			lastCommand = cmd;
-
-			if (cmd == nullptr) {
+			// Execute the next instruction
+			Interpreter::StepResult result = process->executeNextInstruction(coreId);
+			if (result == Interpreter::StepResult::Sleeping) {
+				// The process sleeps off the core and is requeued when it wakes;
+				// none of its sleep counts as active CPU time
+				unsigned int ticks = 1 + process->takeSleepTicks();
+				process->log("Process sleeping for " + std::to_string(ticks) + " ticks.", coreId);
+				Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Sleep));
+				consoleManager.sleepProcess(process, ticks);
+				blocked = true;
+				break;
+			}
+			if (result == Interpreter::StepResult::Finished) {
 				// Process is done; deallocate memory
 				process->setCompleted(true);
 				process->log("Process finished execution.", coreId);
+				Tracer::record(TraceEventType::Complete, process->getId());
 				consoleManager.getMemoryManager().deallocateMemory(process);
 				processCompleted = true;
 				break;
 			}
+			if (result == Interpreter::StepResult::AccessViolation) {
+				process->setCompleted(true);
+				process->log("Process shut down due to memory access violation.", coreId);
+				Tracer::record(TraceEventType::Complete, process->getId(), 1);
+				consoleManager.getMemoryManager().deallocateMemory(process);
+				processCompleted = true;
+				break;
+			}
+			if (result == Interpreter::StepResult::Forked) {
+				// The child resumes after the FORK line and queues like any new process
+				Process* child = consoleManager.forkProcess(process);
+				if (child) {
+					process->log("Forked process " + child->getName() + ".", coreId);
+				}
+				else {
+					process->log("Fork failed.", coreId);
+				}
+			}
+			if (result == Interpreter::StepResult::PageFault) {
+				// Servicing the fault costs this tick; the instruction is retried next tick
+				FaultResult fault = consoleManager.getMemoryManager().handlePageFault(process, process->getFaultAddress());
+				if (fault == FaultResult::Blocked) {
+					// Only this process waits for the swap read. The page-in
+					// handler requeues it, so the core lets go of it now.
+					process->log("Process blocked on page-in.", coreId);
+					Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::PageWait));
+					blocked = true;
+					break;
+				}
+				if (fault == FaultResult::Failed) {
+					// Give up the rest of the quantum; the process is requeued below
+					process->log("Process could not page in memory.", coreId);
+					break;
+				}
+			}
 
-			// Execute the command
 			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			cpuCycles++;
-			consoleManager.getMemoryManager().incrementActiveCpuTicks();
+			consoleManager.getMemoryManager().incrementActiveCpuTicks(process);
 
-			cmd->execute(process, coreId);
-			delete cmd;
-			lastCommand = nullptr;
-
-			process->incrementCurrentLine();
+			// Page-table walks for this instruction's TLB misses stall the core
+			for (uint32_t stall = Tlb::takeStallCycles(coreId); stall > 0; --stall) {
+				cpuCycles++;
+				consoleManager.getMemoryManager().incrementActiveCpuTicks();
+			}
 
 			// Simulate delay-per-exec
 			for (unsigned int i = 0; i < delayPerExec; ++i) {
@@ -268,9 +353,10 @@ void SchedulerRoundRobin::workerLoop(int coreId) {
 		worker->remainingQuantum = 0;
 		lock.unlock();
 
-		if (!processCompleted && !process->isCompleted()) {
+		if (!processCompleted && !blocked && !process->isCompleted()) {
 			// Process still has work to do, requeue it
 			process->log("Process quantum expired, requeueing.", coreId);
+			Tracer::record(TraceEventType::Preempt, process->getId(), static_cast<uint32_t>(PreemptReason::Quantum));
 			addProcess(process);
 		}
 	}
@@ -283,7 +369,8 @@ int SchedulerRoundRobin::getTotalCores() const {
 int SchedulerRoundRobin::getBusyCores() const {
 	int busyCores = 0;
 	for (const Worker* worker : workers) {
-		if (worker->busy.load() && worker->currentProcess != nullptr && worker->currentProcess->isInMemory()) {
+		Process* process = worker->currentProcess.load();
+		if (worker->busy.load() && process != nullptr && process->isInMemory()) {
 			busyCores++;
 		}
 	}
@@ -293,8 +380,9 @@ int SchedulerRoundRobin::getBusyCores() const {
 std::map<Process*, int> SchedulerRoundRobin::getRunningProcesses() const {
 	std::map<Process*, int> runningProcesses;
 	for (const Worker* worker : workers) {
-		if (worker->currentProcess != nullptr && worker->currentProcess->isInMemory()) {
-			runningProcesses[worker->currentProcess] = worker->coreId;
+		Process* process = worker->currentProcess.load();
+		if (process != nullptr && process->isInMemory()) {
+			runningProcesses[process] = worker->coreId;
 		}
 	}
 	return runningProcesses;
@@ -302,23 +390,41 @@ std::map<Process*, int> SchedulerRoundRobin::getRunningProcesses() const {
 
 std::vector<Process*> SchedulerRoundRobin::getQueuedProcesses() const {
 	std::vector<Process*> queuedProcesses;
-	{
-		std::lock_guard<std::mutex> lock(queuedProcessesMutex);
-		for (auto process : queuedProcessesSet) {
-			queuedProcesses.push_back(process);
-		}
-	}
+	forEachQueuedProcess([&queuedProcesses](Process* process) {
+		queuedProcesses.push_back(process);
+		});
 	return queuedProcesses;
 }
 
 std::vector<Process*> SchedulerRoundRobin::getFinishedProcesses() const {
 	std::vector<Process*> finishedProcesses;
+	forEachFinishedProcess([&finishedProcesses](Process* process) {
+		finishedProcesses.push_back(process);
+		});
+	return finishedProcesses;
+}
+
+void SchedulerRoundRobin::forEachQueuedProcess(const std::function<void(Process*)>& visitor) const {
+	std::lock_guard<std::mutex> lock(queuedProcessesMutex);
+	for (Process* process : queuedProcessesSet) {
+		visitor(process);
+	}
+}
+
+void SchedulerRoundRobin::forEachFinishedProcess(const std::function<void(Process*)>& visitor) const {
+	std::vector<Process*> runningProcesses;
+	for (const Worker* worker : workers) {
+		Process* process = worker->currentProcess.load();
+		if (process != nullptr && process->isInMemory()) {
+			runningProcesses.push_back(process);
+		}
+	}
+
 	std::lock_guard<std::mutex> lock(allProcessesMutex);
-	auto runningProcesses = getRunningProcesses();
 	for (Process* process : allProcesses) {
-		if (process->isCompleted() && runningProcesses.find(process) == runningProcesses.end()) {
-			finishedProcesses.push_back(process);
+		if (process->isCompleted()
+			&& std::find(runningProcesses.begin(), runningProcesses.end(), process) == runningProcesses.end()) {
+			visitor(process);
 		}
 	}
-	return finishedProcesses;
 }
\ No newline at end of file
@@ -17,6 +17,8 @@ public:
     ~SchedulerRoundRobin();
 
     void addProcess(Process* process) override;
+    void addProcesses(const std::vector<Process*>& processes) override;
+    void removeProcesses(const std::vector<Process*>& processes) override;
     void start() override;
     void stop() override;
     void pause() override;
@@ -30,6 +32,8 @@ public:
     std::map<Process*, int> getRunningProcesses() const override;
     std::vector<Process*> getQueuedProcesses() const override;
     std::vector<Process*> getFinishedProcesses() const override;
+    void forEachQueuedProcess(const std::function<void(Process*)>& visitor) const override;
+    void forEachFinishedProcess(const std::function<void(Process*)>& visitor) const override;
 
 private:
     void schedulerLoop();
@@ -51,7 +55,7 @@ private:
     struct Worker {
         int coreId = 0;
         std::atomic<bool> busy{ false };
-        Process* currentProcess = nullptr;
+        std::atomic<Process*> currentProcess{ nullptr };    // read by monitors without locking
         unsigned int remainingQuantum = 0;
         std::thread thread;
         std::mutex mtx;
@@ -63,6 +67,7 @@ private:
     ConsoleManager& consoleManager;
 
     std::vector<Process*> allProcesses;
+    std::unordered_set<Process*> allProcessesSet;
     mutable std::mutex allProcessesMutex;
 
     std::atomic<unsigned int> cpuCycles;
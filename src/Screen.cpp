@@ -1,7 +1,7 @@
 #include "Screen.h"
 #include "ConsoleManager.h"
 #include "Process.h"
-#include "PrintCommand.h"
+#include "Program.h"
 #include <iostream>
 #include <sstream>
 #include <ctime>
@@ -36,7 +36,7 @@ void Screen::run() {
                     message.erase(0, 1);
                 }
 
-                process->addCommand(new PrintCommand(message));
+                process->appendPrint(message);
                 std::cout << "Print command added to process.\n";
 
                 // Reset completed status and reschedule if a command is added when process is already finished
@@ -57,6 +57,17 @@ void Screen::run() {
 
 void Screen::displayProcessScreen() {
     std::string processName = process->getName();
+
+    if (process->hasAccessViolation()) {
+        std::time_t violationTime = process->getViolationTime();
+        std::tm timeInfo;
+        localtime_s(&timeInfo, &violationTime);
+        std::cout << "Process " << processName << " shut down due to memory access violation error that occurred at "
+            << std::put_time(&timeInfo, "%H:%M:%S") << ". "
+            << Program::formatAddress(process->getViolationAddress()) << " invalid.\n\n";
+        return;
+    }
+
     int processId = process->getId();
     std::time_t creationTime = process->getCreationTime();
     int currentLine = process->getCurrentLine();
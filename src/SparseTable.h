@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Radix table over indices [0, size) with 64-way nodes. Only the path to
+// an index that has been written is allocated, so memory grows with the
+// entries in use rather than with size; the depth is the fewest levels
+// that cover size, so small tables are a single leaf. Unwritten entries
+// read as a value-initialized T. Entries never move once created.
+template <typename T>
+class SparseTable {
+public:
+    static constexpr unsigned int kFanoutBits = 6;
+    static constexpr uint32_t kFanout = 1u << kFanoutBits;
+
+    explicit SparseTable(uint64_t size = 0)
+        : tableSize(size), depth(1), numLeaves(0) {
+        while (depth * kFanoutBits < 64 && (uint64_t(1) << (depth * kFanoutBits)) < size) {
+            depth++;
+        }
+    }
+
+    SparseTable(const SparseTable& other)
+        : tableSize(other.tableSize), depth(other.depth), numLeaves(other.numLeaves),
+        root(copyNode(other.root.get(), other.depth - 1)) {}
+
+    SparseTable& operator=(const SparseTable& other) {
+        if (this != &other) {
+            tableSize = other.tableSize;
+            depth = other.depth;
+            numLeaves = other.numLeaves;
+            root = copyNode(other.root.get(), other.depth - 1);
+        }
+        return *this;
+    }
+
+    SparseTable(SparseTable&&) = default;
+    SparseTable& operator=(SparseTable&&) = default;
+
+    uint64_t size() const { return tableSize; }
+    size_t getNumLeaves() const { return numLeaves; }
+
+    // The entry, or nullptr if nothing on its path was ever written
+    T* find(uint64_t index) const {
+        const Node* node = root.get();
+        for (unsigned int level = depth - 1; level > 0 && node != nullptr; --level) {
+            node = node->children[(index >> (level * kFanoutBits)) & (kFanout - 1)].get();
+        }
+        if (node == nullptr || !node->items) {
+            return nullptr;
+        }
+        return &node->items[index & (kFanout - 1)];
+    }
+
+    // The entry, allocating its path on first use
+    T& at(uint64_t index) {
+        if (!root) {
+            root.reset(new Node());
+        }
+        Node* node = root.get();
+        for (unsigned int level = depth - 1; level > 0; --level) {
+            std::unique_ptr<Node>& child = node->children[(index >> (level * kFanoutBits)) & (kFanout - 1)];
+            if (!child) {
+                child.reset(new Node());
+            }
+            node = child.get();
+        }
+        if (!node->items) {
+            node->items.reset(new T[kFanout]());
+            numLeaves++;
+        }
+        return node->items[index & (kFanout - 1)];
+    }
+
+    void clear() {
+        root.reset();
+        numLeaves = 0;
+    }
+
+    // Calls visitor(index, entry) for every entry of every allocated leaf,
+    // in index order
+    template <typename Visitor>
+    void forEach(Visitor visitor) {
+        visit(root.get(), depth - 1, 0, visitor);
+    }
+
+    template <typename Visitor>
+    void forEach(Visitor visitor) const {
+        auto constVisitor = [&visitor](uint64_t index, T& entry) { visitor(index, static_cast<const T&>(entry)); };
+        visit(root.get(), depth - 1, 0, constVisitor);
+    }
+
+private:
+    // Interior nodes use children; leaves (level 0) use items
+    struct Node {
+        std::unique_ptr<Node> children[kFanout];
+        std::unique_ptr<T[]> items;
+    };
+
+    static std::unique_ptr<Node> copyNode(const Node* node, unsigned int level) {
+        if (node == nullptr) {
+            return nullptr;
+        }
+        std::unique_ptr<Node> copy(new Node());
+        if (level == 0) {
+            if (node->items) {
+                copy->items.reset(new T[kFanout]);
+                for (uint32_t i = 0; i < kFanout; ++i) {
+                    copy->items[i] = node->items[i];
+                }
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < kFanout; ++i) {
+                copy->children[i] = copyNode(node->children[i].get(), level - 1);
+            }
+        }
+        return copy;
+    }
+
+    // prefix holds the index bits above this node
+    template <typename Visitor>
+    static void visit(const Node* node, unsigned int level, uint64_t prefix, Visitor& visitor) {
+        if (node == nullptr) {
+            return;
+        }
+        if (level == 0) {
+            if (node->items) {
+                for (uint32_t i = 0; i < kFanout; ++i) {
+                    visitor((prefix << kFanoutBits) | i, node->items[i]);
+                }
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < kFanout; ++i) {
+            visit(node->children[i].get(), level - 1, (prefix << kFanoutBits) | i, visitor);
+        }
+    }
+
+    uint64_t tableSize;
+    unsigned int depth;
+    size_t numLeaves;
+    std::unique_ptr<Node> root;
+};
+
+template <typename T>
+constexpr unsigned int SparseTable<T>::kFanoutBits;
+template <typename T>
+constexpr uint32_t SparseTable<T>::kFanout;
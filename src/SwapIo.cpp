@@ -0,0 +1,60 @@
+#include "SwapIo.h"
+#include <algorithm>
+
+SwapIo::SwapIo(unsigned int numThreads)
+    : numInFlight(0), numCompleted(0) {
+    numThreads = std::max(1u, numThreads);
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        ioThreads.emplace_back([this]() {
+            Request request;
+            while (submissions.wait_and_pop(request)) {
+                if (request.transfer) {
+                    request.transfer();
+                }
+                completions.push(std::move(request));
+            }
+        });
+    }
+    completionThread = std::thread([this]() {
+        Request request;
+        while (completions.wait_and_pop(request)) {
+            if (request.complete) {
+                request.complete();
+            }
+            request = Request();
+            numCompleted++;
+            std::lock_guard<std::mutex> lock(drainMutex);
+            if (--numInFlight == 0) {
+                drainCV.notify_all();
+            }
+        }
+    });
+}
+
+SwapIo::~SwapIo() {
+    drain();
+    submissions.stop();
+    for (std::thread& thread : ioThreads) {
+        thread.join();
+    }
+    completions.stop();
+    completionThread.join();
+}
+
+void SwapIo::submit(Request request) {
+    numInFlight++;
+    submissions.push(std::move(request));
+}
+
+void SwapIo::drain() {
+    std::unique_lock<std::mutex> lock(drainMutex);
+    drainCV.wait(lock, [this]() { return numInFlight.load() == 0; });
+}
+
+unsigned int SwapIo::getNumInFlight() const {
+    return numInFlight.load();
+}
+
+unsigned long long SwapIo::getNumCompleted() const {
+    return numCompleted.load();
+}
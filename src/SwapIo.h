@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadSafeQueue.h"
+
+// Submission and completion queues in front of a small pool of swap I/O
+// threads. A request's transfer runs on whichever I/O thread is free with
+// no lock held; its completion then runs on a single completion thread,
+// one at a time in the order transfers finish, and takes whatever locks
+// it needs itself.
+class SwapIo {
+public:
+    struct Request {
+        std::function<void()> transfer;
+        std::function<void()> complete;
+    };
+
+    explicit SwapIo(unsigned int numThreads);
+    ~SwapIo();      // finishes everything submitted first
+
+    SwapIo(const SwapIo&) = delete;
+    SwapIo& operator=(const SwapIo&) = delete;
+
+    void submit(Request request);
+
+    // Blocks until every request submitted so far has completed. Must not
+    // be called holding a lock that completions take.
+    void drain();
+
+    unsigned int getNumInFlight() const;
+    unsigned long long getNumCompleted() const;
+
+private:
+    ThreadSafeQueue<Request> submissions;
+    ThreadSafeQueue<Request> completions;
+    std::vector<std::thread> ioThreads;
+    std::thread completionThread;
+
+    std::atomic<unsigned int> numInFlight;
+    std::atomic<unsigned long long> numCompleted;
+    std::mutex drainMutex;
+    std::condition_variable drainCV;
+};
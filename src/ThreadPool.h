@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadSafeQueue.h"
+
+// Fixed set of worker threads for bulk work such as batched process
+// creation. Tasks run in submission order on whichever worker is free.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int numThreads = std::thread::hardware_concurrency()) {
+        numThreads = std::max(1u, numThreads);
+        for (unsigned int i = 0; i < numThreads; ++i) {
+            workers.emplace_back([this]() {
+                std::function<void()> task;
+                while (tasks.wait_and_pop(task)) {
+                    task();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        tasks.stop();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    // Calls body(begin, end) over contiguous chunks of [0, count) on the
+    // workers and blocks until every chunk has finished
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) return;
+
+        size_t numChunks = std::min(count, static_cast<size_t>(workers.size()) * 4);
+        size_t chunkSize = (count + numChunks - 1) / numChunks;
+
+        std::mutex doneMutex;
+        std::condition_variable doneCV;
+        size_t remaining = (count + chunkSize - 1) / chunkSize;
+
+        for (size_t begin = 0; begin < count; begin += chunkSize) {
+            size_t end = std::min(count, begin + chunkSize);
+            tasks.push([&, begin, end]() {
+                body(begin, end);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--remaining == 0) {
+                    doneCV.notify_one();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCV.wait(lock, [&remaining]() { return remaining == 0; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    ThreadSafeQueue<std::function<void()>> tasks;
+};
@@ -14,6 +14,16 @@ public:
         cv.notify_one();
     }
 
+    // Enqueues a batch under one lock acquisition
+    template<typename Iterator>
+    void push_all(Iterator first, Iterator last) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (; first != last; ++first) {
+            queue.push(*first);
+        }
+        cv.notify_all();
+    }
+
     bool wait_and_pop(T& item) {
         std::unique_lock<std::mutex> lock(mtx);
         cv.wait(lock, [this]() { return !queue.empty() || stopped; });
@@ -25,6 +35,16 @@ public:
         return true;
     }
 
+    // Copies the item at the head without removing it
+    bool try_peek(T& item) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.empty()) {
+            return false;
+        }
+        item = queue.front();
+        return true;
+    }
+
     bool try_pop(T& item) {
         std::lock_guard<std::mutex> lock(mtx);
         if (queue.empty()) {
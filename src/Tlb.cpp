@@ -0,0 +1,113 @@
+#include "Tlb.h"
+
+constexpr int Tlb::kMaxCores;
+constexpr unsigned int Tlb::kNumSets;
+constexpr unsigned int Tlb::kNumWays;
+constexpr uint32_t Tlb::kWalkCycles;
+constexpr uint64_t Tlb::kInvalid;
+
+namespace {
+
+std::atomic<int> numCoresUsed(0);
+std::atomic<uint64_t> numShootdowns(0);
+
+}
+
+Tlb Tlb::cores[Tlb::kMaxCores];
+
+Tlb::Tlb()
+    : hits(0), misses(0), stallCycles(0) {
+    for (auto& set : entries) {
+        for (auto& entry : set) {
+            entry.tag.store(kInvalid, std::memory_order_relaxed);
+            entry.slot = nullptr;
+        }
+    }
+    for (auto& way : nextWay) {
+        way = 0;
+    }
+}
+
+Tlb* Tlb::forCore(int coreId) {
+    if (coreId < 0 || coreId >= kMaxCores) {
+        return nullptr;
+    }
+    int used = numCoresUsed.load(std::memory_order_relaxed);
+    while (used <= coreId && !numCoresUsed.compare_exchange_weak(used, coreId + 1)) {
+    }
+    return &cores[coreId];
+}
+
+PageSlot* Tlb::lookup(uint32_t asid, uint32_t page) {
+    uint64_t tag = makeTag(asid, page);
+    Entry* set = entries[page % kNumSets];
+    for (unsigned int way = 0; way < kNumWays; ++way) {
+        if (set[way].tag.load(std::memory_order_relaxed) == tag) {
+            hits.store(hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return set[way].slot;
+        }
+    }
+    misses.store(misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stallCycles += kWalkCycles;
+    return nullptr;
+}
+
+void Tlb::fill(uint32_t asid, uint32_t page, PageSlot* slot) {
+    unsigned int index = page % kNumSets;
+    Entry& entry = entries[index][nextWay[index]];
+    nextWay[index] = static_cast<uint8_t>((nextWay[index] + 1) % kNumWays);
+    entry.slot = slot;
+    entry.tag.store(makeTag(asid, page), std::memory_order_relaxed);
+}
+
+void Tlb::shootdown(uint32_t asid, uint32_t page) {
+    uint64_t tag = makeTag(asid, page);
+    int used = numCoresUsed.load(std::memory_order_relaxed);
+    for (int core = 0; core < used; ++core) {
+        for (auto& entry : cores[core].entries[page % kNumSets]) {
+            uint64_t expected = tag;
+            if (entry.tag.compare_exchange_strong(expected, kInvalid, std::memory_order_relaxed)) {
+                numShootdowns.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void Tlb::flushAsid(uint32_t asid) {
+    int used = numCoresUsed.load(std::memory_order_relaxed);
+    for (int core = 0; core < used; ++core) {
+        for (auto& set : cores[core].entries) {
+            for (auto& entry : set) {
+                uint64_t tag = entry.tag.load(std::memory_order_relaxed);
+                if (tag != kInvalid && (tag >> 32) == asid) {
+                    entry.tag.compare_exchange_strong(tag, kInvalid, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+}
+
+uint32_t Tlb::takeStallCycles(int coreId) {
+    if (coreId < 0 || coreId >= kMaxCores) {
+        return 0;
+    }
+    uint32_t cycles = cores[coreId].stallCycles;
+    cores[coreId].stallCycles = 0;
+    return cycles;
+}
+
+uint64_t Tlb::getHits() const {
+    return hits.load(std::memory_order_relaxed);
+}
+
+uint64_t Tlb::getMisses() const {
+    return misses.load(std::memory_order_relaxed);
+}
+
+int Tlb::getNumCoresUsed() {
+    return numCoresUsed.load(std::memory_order_relaxed);
+}
+
+uint64_t Tlb::getNumShootdowns() {
+    return numShootdowns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+struct PageSlot;
+
+// Software model of a per-core translation lookaside buffer: a small
+// set-associative cache from (ASID, virtual page) to the page's slot in
+// its process's page table, with the process ID as the ASID so a context switch needs no
+// flush. Only the worker running on a core looks up and fills its TLB.
+// Other threads shoot entries down by clearing their tags; every change
+// to a process's page map happens under that process's program lock,
+// which the core also holds while translating for it, so a shot-down
+// entry is never used again.
+class Tlb {
+public:
+    static constexpr int kMaxCores = 128;
+    static constexpr unsigned int kNumSets = 16;
+    static constexpr unsigned int kNumWays = 4;
+    static constexpr uint32_t kWalkCycles = 1;     // ticks a miss stalls the core
+
+    // nullptr for a core outside [0, kMaxCores)
+    static Tlb* forCore(int coreId);
+
+    // Cached slot of the page, or nullptr on a miss
+    PageSlot* lookup(uint32_t asid, uint32_t page);
+    void fill(uint32_t asid, uint32_t page, PageSlot* slot);
+
+    // Drop the translation, or every translation of an address space, on all cores
+    static void shootdown(uint32_t asid, uint32_t page);
+    static void flushAsid(uint32_t asid);
+
+    // Cycles owed for page-table walks since the last call on this core
+    static uint32_t takeStallCycles(int coreId);
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    static int getNumCoresUsed();       // one past the highest core seen
+    static uint64_t getNumShootdowns();
+
+private:
+    static constexpr uint64_t kInvalid = ~uint64_t(0);
+
+    struct Entry {
+        std::atomic<uint64_t> tag;      // asid << 32 | page
+        PageSlot* slot;
+    };
+
+    Tlb();
+
+    // Static storage, so a shootdown can walk every core without a lock
+    static Tlb cores[kMaxCores];
+
+    static uint64_t makeTag(uint32_t asid, uint32_t page) {
+        return (uint64_t(asid) << 32) | page;
+    }
+
+    alignas(64) Entry entries[kNumSets][kNumWays];
+    uint8_t nextWay[kNumSets];          // round-robin replacement within a set
+
+    // Written only by the core's worker; monitors read them unlocked
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    uint32_t stallCycles;
+};
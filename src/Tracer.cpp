@@ -0,0 +1,207 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+constexpr size_t Tracer::kBufferCapacity;
+
+std::atomic<bool> Tracer::enabled(false);
+thread_local Tracer::Buffer* Tracer::localBuffer = nullptr;
+thread_local int Tracer::currentCore = -1;
+
+namespace {
+
+// Tracks of threads that are not scheduler cores sit after the cores
+const int kFirstNonCoreTrack = 1000;
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+const char* instantName(TraceEventType type) {
+    switch (type) {
+    case TraceEventType::PageIn: return "page-in";
+    case TraceEventType::PageOut: return "page-out";
+    case TraceEventType::Evict: return "evict";
+    case TraceEventType::CopyOnWrite: return "copy-on-write";
+    default: return "";
+    }
+}
+
+} // namespace
+
+Tracer& Tracer::getInstance() {
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer()
+    : startCycles(0), startTime(std::chrono::steady_clock::now()) {}
+
+void Tracer::start() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (enabled.load()) {
+        return;
+    }
+    for (auto& buffer : buffers) {
+        buffer->count.store(0, std::memory_order_relaxed);
+    }
+    startTime = std::chrono::steady_clock::now();
+    startCycles = readCycleCounter();
+    enabled.store(true);
+}
+
+void Tracer::stop() {
+    enabled.store(false);
+    waitForWriters();
+}
+
+void Tracer::setCurrentCore(int coreId) {
+    currentCore = coreId;
+}
+
+Tracer::Buffer* Tracer::registerThread() {
+    std::unique_ptr<Buffer> buffer(new Buffer());
+    buffer->coreId = currentCore;
+    localBuffer = buffer.get();
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers.push_back(std::move(buffer));
+    return localBuffer;
+}
+
+void Tracer::waitForWriters() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (auto& buffer : buffers) {
+        while (buffer->writing.load()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+long long Tracer::exportChromeTrace(const std::string& path, const std::unordered_map<int, std::string>& processNames) {
+    stop();
+
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        return -1;
+    }
+    out << std::fixed << std::setprecision(3);
+
+    // Convert cycles to microseconds against the wall time elapsed since start
+    uint64_t endCycles = readCycleCounter();
+    double elapsedMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    double cyclesPerMicro = elapsedMicros > 0 && endCycles > startCycles
+        ? (endCycles - startCycles) / elapsedMicros : 1.0;
+    auto toMicros = [&](uint64_t cycles) {
+        return cycles > startCycles ? (cycles - startCycles) / cyclesPerMicro : 0.0;
+    };
+    auto nameOf = [&](int pid) {
+        auto it = processNames.find(pid);
+        return it != processNames.end() ? escapeJson(it->second) : "PID " + std::to_string(pid);
+    };
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    long long written = 0;
+    bool first = true;
+    auto beginEvent = [&]() -> std::ofstream& {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        written++;
+        return out;
+    };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    beginEvent() << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"OS Emulator\"}}";
+
+    int nonCoreTrack = kFirstNonCoreTrack;
+    std::vector<int> namedTracks;
+    for (auto& buffer : buffers) {
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        if (count == 0) continue;
+
+        int track = buffer->coreId >= 0 ? buffer->coreId : nonCoreTrack++;
+        if (std::find(namedTracks.begin(), namedTracks.end(), track) == namedTracks.end()) {
+            namedTracks.push_back(track);
+            std::string trackName = buffer->coreId >= 0 ? "Core " + std::to_string(track) : "Thread " + std::to_string(track);
+            beginEvent() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << track
+                << ",\"args\":{\"name\":\"" << trackName << "\"}}";
+        }
+
+        // Once the buffer has wrapped only the newest kBufferCapacity remain
+        uint64_t firstIndex = count > kBufferCapacity ? count - kBufferCapacity : 0;
+        bool running = false;
+        int runningPid = 0;
+        double runningSince = 0;
+
+        auto closeSlice = [&](double end, const char* reason) {
+            beginEvent() << "{\"name\":\"" << nameOf(runningPid) << "\",\"cat\":\"sched\",\"ph\":\"X\",\"ts\":"
+                << runningSince << ",\"dur\":" << (end - runningSince) << ",\"pid\":0,\"tid\":" << track
+                << ",\"args\":{\"pid\":" << runningPid << ",\"end\":\"" << reason << "\"}}";
+            running = false;
+        };
+
+        for (uint64_t i = firstIndex; i < count; ++i) {
+            const TraceEvent& event = buffer->events[i & (kBufferCapacity - 1)];
+            double ts = toMicros(event.timestamp);
+
+            switch (event.type) {
+            case TraceEventType::Dispatch:
+                if (running) closeSlice(ts, "unknown");
+                running = true;
+                runningPid = event.processId;
+                runningSince = ts;
+                break;
+            case TraceEventType::Preempt:
+            case TraceEventType::Complete: {
+                // A slice whose dispatch was overwritten is dropped
+                if (!running || runningPid != event.processId) break;
+                const char* reason;
+                if (event.type == TraceEventType::Complete) {
+                    reason = event.arg0 != 0 ? "access violation" : "finished";
+                }
+                else {
+                    switch (static_cast<PreemptReason>(event.arg0)) {
+                    case PreemptReason::Memory: reason = "memory"; break;
+                    case PreemptReason::PageWait: reason = "page wait"; break;
+                    case PreemptReason::Sleep: reason = "sleep"; break;
+                    default: reason = "quantum"; break;
+                    }
+                }
+                closeSlice(ts, reason);
+                beginEvent() << "{\"name\":\"" << (event.type == TraceEventType::Complete ? "complete" : "preempt")
+                    << "\",\"cat\":\"sched\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts << ",\"pid\":0,\"tid\":" << track
+                    << ",\"args\":{\"pid\":" << event.processId << ",\"reason\":\"" << reason << "\"}}";
+                break;
+            }
+            default:
+                beginEvent() << "{\"name\":\"" << instantName(event.type) << "\",\"cat\":\"memory\",\"ph\":\"i\",\"s\":\"t\",\"ts\":"
+                    << ts << ",\"pid\":0,\"tid\":" << track << ",\"args\":{\"pid\":" << event.processId
+                    << ",\"process\":\"" << nameOf(event.processId) << "\",\"page\":" << event.arg0
+                    << ",\"frame\":" << static_cast<int32_t>(event.arg1) << "}}";
+                break;
+            }
+        }
+        if (running) {
+            closeSlice(toMicros(endCycles), "still running");
+        }
+    }
+
+    out << "\n]}\n";
+    return written;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum class TraceEventType : uint8_t {
+    Dispatch,       // a process starts running on the core
+    Preempt,        // it leaves the core with work left; arg0 is a PreemptReason
+    Complete,       // it leaves the core for good; arg0 is 1 after an access violation
+    PageIn,         // arg0 = page, arg1 = frame
+    PageOut,        // a dirty page was written to the backing store
+    Evict,          // a resident page lost its frame
+    CopyOnWrite     // a shared page was copied for the writer
+};
+
+enum class PreemptReason : uint32_t {
+    Quantum,
+    Memory,
+    PageWait,       // blocked on a swap read
+    Sleep           // waiting out a SLEEP instruction
+};
+
+struct TraceEvent {
+    uint64_t timestamp;     // raw cycle counter
+    int32_t processId;
+    uint32_t arg0;
+    uint32_t arg1;
+    TraceEventType type;
+};
+
+// Low-overhead scheduling timeline. Every thread records into its own
+// buffer, so a worker's buffer is effectively its core's; recording is a
+// cycle-counter read and a few stores with no lock. Each buffer keeps the
+// most recent kBufferCapacity events, so tracing can stay on in long runs.
+// The timeline is exported as Chrome Trace Event JSON, which Perfetto and
+// chrome://tracing open directly.
+class Tracer {
+public:
+    static constexpr size_t kBufferCapacity = 1 << 16;     // events per thread, a power of two
+
+    static Tracer& getInstance();
+
+    void start();   // clears previously recorded events
+    void stop();
+    static bool isEnabled();
+
+    // Scheduler workers call this once so their events land on their core's track
+    static void setCurrentCore(int coreId);
+
+    static void record(TraceEventType type, int processId, uint32_t arg0 = 0, uint32_t arg1 = 0);
+
+    // Stops recording and writes everything kept so far. processNames maps
+    // PIDs to display names; unknown PIDs are shown by number. Returns the
+    // number of trace events written, or -1 if the file could not be opened.
+    long long exportChromeTrace(const std::string& path, const std::unordered_map<int, std::string>& processNames);
+
+private:
+    struct Buffer {
+        TraceEvent events[kBufferCapacity];
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<bool> writing{ false };
+        int coreId = -1;
+    };
+
+    Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static uint64_t readCycleCounter();
+    Buffer* registerThread();
+    void waitForWriters();
+
+    static std::atomic<bool> enabled;
+    static thread_local Buffer* localBuffer;
+    static thread_local int currentCore;
+
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    mutable std::mutex buffersMutex;
+
+    // Pairs a cycle count with wall time at start and export, to convert
+    // cycles to microseconds
+    uint64_t startCycles;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+inline bool Tracer::isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+inline uint64_t Tracer::readCycleCounter() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+inline void Tracer::record(TraceEventType type, int processId, uint32_t arg0, uint32_t arg1) {
+    if (!isEnabled()) {
+        return;
+    }
+    Buffer* buffer = localBuffer != nullptr ? localBuffer : getInstance().registerThread();
+
+    // Paired with stop(): either the exporter sees this write in progress
+    // and waits for it, or this thread sees that tracing has stopped. Both
+    // sides need sequentially consistent accesses for that to hold.
+    buffer->writing.store(true);
+    if (!enabled.load()) {
+        buffer->writing.store(false, std::memory_order_release);
+        return;
+    }
+
+    uint64_t n = buffer->count.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[n & (kBufferCapacity - 1)];
+    event.timestamp = readCycleCounter();
+    event.processId = processId;
+    event.arg0 = arg0;
+    event.arg1 = arg1;
+    event.type = type;
+    buffer->count.store(n + 1, std::memory_order_release);
+    buffer->writing.store(false, std::memory_order_release);
+}